@@ -53,15 +53,37 @@
 #define UTIL_WEIGHT .60
 
 /* 
- * Alignment requirement in bytes (either 4 or 8) 
+ * Alignment requirement in bytes (either 4 or 8, or 16 when mm.c is
+ * built with -DALIGN16)
  */
+#ifdef ALIGN16
+#define ALIGNMENT 16
+#else
 #define ALIGNMENT 8  
+#endif
 
 /* 
  * Maximum heap size in bytes 
  */
 #define MAX_HEAP (20*(1<<20))  /* 20 MB */
 
+/* 
+ * mmap backing store (MEMLIB=MMAP): address space reserved per region,
+ * number of sbrk regions, side regions and mappings, and the step in
+ * which reserved pages are committed
+ */
+#define REGION_RESERVE ((size_t)1 << 32)  /* 4 GB */
+#define MAX_REGIONS 16
+#define MAX_SIDE_REGIONS 8
+#define MAX_MAPPINGS 4096
+#ifdef MEMLIB_HUGE
+/* HUGE=1/TLB: regions are hugepage aligned and committed a hugepage at a time */
+#define HUGE_PAGE_SIZE (2*(1<<20))        /* 2 MB */
+#define COMMIT_CHUNK HUGE_PAGE_SIZE
+#else
+#define COMMIT_CHUNK (64*(1<<10))         /* 64 KB */
+#endif
+
 /*****************************************************************************
  * Set exactly one of these USE_xxx constants to "1" to select a timing method
  *****************************************************************************/
@@ -0,0 +1,260 @@
+/*
+ * fixedbench.c - Time mm.h's fixed-size fast path, in cycles per request
+ *
+ * Usage: fixedbench [-n <objects>] [-r <reps>] [-v <ops>] [-S <seed>]
+ *
+ * Each timed round allocates -n objects of OBJ_SIZE bytes (a
+ * compile-time constant, as the fast path expects) and frees them
+ * again in reverse order, three ways: by bumping a pointer through a
+ * preallocated buffer (the floor the fast path aims at), through
+ * mm_malloc_fixed / mm_free_fixed, and through mm_malloc / mm_free.
+ * Up to MM_FIXED_BIN_MAX objects a round stays within the bins; more
+ * than that also times the refills and drains. Before timing, a
+ * validity run replays -v random mallocs and frees of many sizes
+ * through the fixed calls, checking alignment, overlap and data, that
+ * the bins never hold more than MM_FIXED_CAP bytes, and (in CHECK=1
+ * builds) the heap with mm_check:
+ *
+ *	unix> make fixedbench && ./fixedbench
+ *	unix> ./fixedbench -n 1000
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "clock.h"
+
+#ifndef OBJ_SIZE
+#define OBJ_SIZE 32		/* payload of a timed object, e.g. a list node */
+#endif
+#define LIVE_MAX 512	/* live blocks in the validity run */
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ull;
+
+/* Live blocks of the validity run */
+static char *live[LIVE_MAX];
+static int live_size[LIVE_MAX];
+
+static void usage(void);
+static void bench_error(char *msg);
+static unsigned rnd(void);
+static void validity(int ops);
+static unsigned long long cycles(void);
+static int cmp_ull(const void *a, const void *b);
+static int cmp_live(const void *a, const void *b);
+
+int main(int argc, char **argv)
+{
+	int c, i, k;
+	int n = 32, reps = 101, vops = 200000;
+	char *bump, *top;
+	void **objs;
+	unsigned long long t, *secs[3];
+	char *names[3] = {"bump", "mm_malloc_fixed", "mm_malloc"};
+
+	while ((c = getopt(argc, argv, "n:r:v:S:h")) != EOF)
+		switch (c)
+		{
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 'r':
+			reps = atoi(optarg);
+			break;
+		case 'v':
+			vops = atoi(optarg);
+			break;
+		case 'S':
+			rng_state = strtoull(optarg, NULL, 0) | 1;
+			break;
+		case 'h':
+			usage();
+			exit(0);
+		default:
+			usage();
+			exit(1);
+		}
+	if (n < 1 || reps < 1 || vops < 0)
+		bench_error("-n and -r must be positive, -v not negative");
+
+	objs = malloc(n * sizeof(void *));
+	bump = malloc((size_t)n * MM_ASIZE(OBJ_SIZE));
+	for (k = 0; k < 3; k++)
+		secs[k] = malloc(reps * sizeof(unsigned long long));
+	if (objs == NULL || bump == NULL || secs[0] == NULL || secs[1] == NULL ||
+		secs[2] == NULL)
+		bench_error("out of memory");
+
+	mem_init();
+	if (mm_init() < 0)
+		bench_error("mm_init failed");
+	validity(vops);
+
+	/* One untimed round of each warms the caches and fills the bins */
+	for (i = 0; i <= reps; i++)
+	{
+		t = cycles();
+		for (top = bump, k = 0; k < n; k++, top += MM_ASIZE(OBJ_SIZE))
+			objs[k] = top;
+		for (k = n - 1; k >= 0; k--)
+			top -= MM_ASIZE(OBJ_SIZE);
+		if (i > 0)
+			secs[0][i - 1] = cycles() - t;
+		if (top != bump)
+			bench_error("bump pointer out of step");
+
+		t = cycles();
+		for (k = 0; k < n; k++)
+			if ((objs[k] = mm_malloc_fixed(OBJ_SIZE)) == NULL)
+				bench_error("mm_malloc_fixed failed");
+		for (k = n - 1; k >= 0; k--)
+			mm_free_fixed(objs[k], OBJ_SIZE);
+		if (i > 0)
+			secs[1][i - 1] = cycles() - t;
+
+		t = cycles();
+		for (k = 0; k < n; k++)
+			if ((objs[k] = mm_malloc(OBJ_SIZE)) == NULL)
+				bench_error("mm_malloc failed");
+		for (k = n - 1; k >= 0; k--)
+			mm_free(objs[k]);
+		if (i > 0)
+			secs[2][i - 1] = cycles() - t;
+	}
+
+	printf("%d objects of %d bytes, %d reps (median, min cycles per malloc+free)\n",
+		   n, OBJ_SIZE, reps);
+	for (k = 0; k < 3; k++)
+	{
+		qsort(secs[k], reps, sizeof(unsigned long long), cmp_ull);
+		printf("%-18s%10.1f%10.1f\n", names[k],
+			   (double)secs[k][reps / 2] / n, (double)secs[k][0] / n);
+	}
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: fixedbench [-n <objects>] [-r <reps>] [-v <ops>] [-S <seed>]\n");
+	fprintf(stderr, "Options\n");
+	fprintf(stderr, "\t-n <objects>  Objects allocated and freed per round (default 32).\n");
+	fprintf(stderr, "\t-r <reps>     Timed rounds of each kind (default 101).\n");
+	fprintf(stderr, "\t-v <ops>      Requests in the validity run (default 200000).\n");
+	fprintf(stderr, "\t-S <seed>     Random seed for the validity run.\n");
+}
+
+static void bench_error(char *msg)
+{
+	fprintf(stderr, "fixedbench: %s\n", msg);
+	exit(1);
+}
+
+/*
+ * rnd - xorshift64*, enough for picking sizes and victims
+ */
+static unsigned rnd(void)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return (unsigned)((rng_state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+/*
+ * validity - Replay ops random mallocs and frees of 1 to 1024 bytes
+ *     (run-time sizes, so both sides of MM_FIXED_MAX) through
+ *     mm_malloc_fixed / mm_free_fixed and check every block
+ */
+static void validity(int ops)
+{
+	int order[LIVE_MAX];
+	int i, j, n = 0, v;
+
+	for (i = 0; i < ops; i++)
+	{
+		if (n < LIVE_MAX && (n == 0 || rnd() % 2 == 0))
+		{
+			live_size[n] = 1 + rnd() % 1024;
+			if ((live[n] = mm_malloc_fixed(live_size[n])) == NULL)
+				bench_error("validity: mm_malloc_fixed failed");
+			if ((unsigned long)live[n] % MM_ALIGN != 0)
+				bench_error("validity: block is not aligned");
+			memset(live[n], n & 0xFF, live_size[n]);
+			n++;
+		}
+		else
+		{
+			v = rnd() % n;
+			for (j = 0; j < live_size[v]; j++)
+				if ((unsigned char)live[v][j] != (v & 0xFF))
+					bench_error("validity: block lost its data");
+			mm_free_fixed(live[v], live_size[v]);
+			n--;
+			if (v != n)
+			{
+				/* Move the last block into the hole and relabel its data */
+				live[v] = live[n];
+				live_size[v] = live_size[n];
+				memset(live[v], v & 0xFF, live_size[v]);
+			}
+#ifndef THREAD_CACHE
+			if (mm_fixed_bytes > MM_FIXED_CAP)
+				bench_error("validity: the bins hold more than MM_FIXED_CAP bytes");
+#endif
+		}
+
+		/* Every so often, no two live blocks may overlap */
+		if (i % 1000 == 999)
+		{
+			for (j = 0; j < n; j++)
+				order[j] = j;
+			qsort(order, n, sizeof(int), cmp_live);
+			for (j = 1; j < n; j++)
+				if (live[order[j]] < live[order[j - 1]] + live_size[order[j - 1]])
+					bench_error("validity: two live blocks overlap");
+		}
+	}
+	while (n > 0)
+	{
+		n--;
+		mm_free_fixed(live[n], live_size[n]);
+	}
+#ifdef MM_CHECK
+	if (mm_check() != 0)
+		bench_error("validity: mm_check found problems");
+#endif
+	printf("validity: %d requests ok\n", ops);
+}
+
+/*
+ * cycles - Current value of the cycle counter
+ */
+static unsigned long long cycles(void)
+{
+	unsigned hi, lo;
+
+	access_counter(&hi, &lo);
+	return ((unsigned long long)hi << 32) | lo;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * cmp_live - qsort order of live block indices by address
+ */
+static int cmp_live(const void *a, const void *b)
+{
+	char *x = live[*(const int *)a];
+	char *y = live[*(const int *)b];
+
+	return (x > y) - (x < y);
+}
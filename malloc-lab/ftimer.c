@@ -7,8 +7,10 @@
  * Function timers that estimate the running time (in seconds) of a function f.
  *    ftimer_itimer: version that uses the interval timer
  *    ftimer_gettod: version that uses gettimeofday
+ *    ftimer_clock: version that uses clock_gettime(CLOCK_MONOTONIC)
  */
 #include <stdio.h>
+#include <time.h>
 #include <sys/time.h>
 #include "ftimer.h"
 
@@ -52,6 +54,23 @@ double ftimer_gettod(ftimer_test_funct f, void *argp, int n)
     return (1E-3*diff);
 }
 
+/*
+ * ftimer_clock - Use the monotonic clock to estimate the running time
+ * of f(argp). Return the average of n runs. Unlike gettimeofday it
+ * resolves nanoseconds and never steps with the wall clock.
+ */
+double ftimer_clock(ftimer_test_funct f, void *argp, int n)
+{
+    int i;
+    struct timespec sts, ets;
+
+    clock_gettime(CLOCK_MONOTONIC, &sts);
+    for (i = 0; i < n; i++)
+	f(argp);
+    clock_gettime(CLOCK_MONOTONIC, &ets);
+    return ((ets.tv_sec - sts.tv_sec) + 1E-9*(ets.tv_nsec - sts.tv_nsec)) / n;
+}
+
 
 /*
  * Routines for manipulating the Unix interval timer
@@ -0,0 +1,452 @@
+/*
+ * gentrace.c - Generate synthetic traces with production-like shapes
+ *
+ * Usage: gentrace [-n <ops>] [-s <dist>]... [-l <dist>]... [-p <ops>]
+ *                 [-L <bytes>] [-r <frac>] [-S <seed>] <out.rep|out.bin>
+ *
+ * Every allocation draws its size from a size distribution and its
+ * lifetime (in requests) from a lifetime distribution; it is freed
+ * once its lifetime has passed. With -L, blocks are also freed early,
+ * soonest-to-die first, whenever the live payload reaches the target,
+ * so the trace settles around that live set. Giving -s or -l more
+ * than once defines phases: phase i uses the i-th size and lifetime
+ * distributions (cycling if one list is shorter), and each phase lasts
+ * -p requests. All blocks still live at the end are freed, so the
+ * trace has exactly -n requests.
+ *
+ * Distributions:
+ *   uni:<lo>:<hi>            uniform on [lo, hi]
+ *   pow:<lo>:<hi>:<alpha>    bounded power law (Pareto) on [lo, hi]
+ *   bi:<a>:<b>:<p>           a with probability p, otherwise b
+ *   exp:<mean>               exponential (lifetimes)
+ *   hist:<file>              "<value> <weight>" lines
+ *
+ * Block ids are recycled once freed, so num_ids tracks the largest
+ * live set rather than the trace length. A name ending in .bin gets
+ * the binary format of trace.h, anything else a .rep text trace.
+ * Both are written in one pass; the header is filled in at the end.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define MAX_PHASES 16
+#define MAX_HIST 4096		/* entries in a hist: distribution */
+#define MAX_SIZE (1 << 30)	/* largest request size */
+#define REP_HDR_WIDTH 12	/* digits reserved for each .rep header field */
+
+/* A distribution of positive integers (sizes or lifetimes) */
+typedef struct
+{
+	enum
+	{
+		DIST_UNI,
+		DIST_POW,
+		DIST_BI,
+		DIST_EXP,
+		DIST_HIST
+	} kind;
+	double a, b, c;	   /* parameters, see the usage comment */
+	int hist_n;		   /* DIST_HIST: number of entries */
+	double *hist_cum;  /* cumulative weights */
+	long *hist_val;
+} dist_t;
+
+/* A live block, kept in a min-heap on its time of death */
+typedef struct
+{
+	long death; /* request number at which it is freed */
+	int id;
+	int size;
+} live_t;
+
+/* The trace being written */
+typedef struct
+{
+	FILE *fp;
+	int binary;
+	long num_ops;
+	int num_ids;
+	long live_bytes, peak_bytes;
+} out_t;
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ull;
+
+static live_t *live;	  /* min-heap of live blocks */
+static int num_live = 0;
+static int *free_ids;	  /* recycled block ids */
+static int num_free_ids = 0;
+
+static void usage(void);
+static void gen_error(char *msg, char *arg);
+static double rnd(void);
+static void parse_dist(dist_t *d, char *spec);
+static void read_hist(dist_t *d, char *path);
+static long draw(dist_t *d);
+static void live_push(live_t b);
+static live_t live_pop(void);
+static void live_sift_down(int i);
+static void emit(out_t *out, int type, int id, int size);
+static void write_header(out_t *out);
+
+int main(int argc, char **argv)
+{
+	dist_t sizes[MAX_PHASES], lifes[MAX_PHASES];
+	int num_sizes = 0, num_lifes = 0;
+	long num_ops = 100000, phase_len = 0, target = 0, t;
+	double realloc_frac = 0;
+	out_t out;
+	char *path;
+	int c, len;
+
+	while ((c = getopt(argc, argv, "n:s:l:p:L:r:S:")) != EOF)
+	{
+		switch (c)
+		{
+		case 'n':
+			num_ops = atol(optarg);
+			break;
+		case 's':
+			if (num_sizes == MAX_PHASES)
+				gen_error("too many -s phases", optarg);
+			parse_dist(&sizes[num_sizes++], optarg);
+			break;
+		case 'l':
+			if (num_lifes == MAX_PHASES)
+				gen_error("too many -l phases", optarg);
+			parse_dist(&lifes[num_lifes++], optarg);
+			break;
+		case 'p':
+			phase_len = atol(optarg);
+			break;
+		case 'L':
+			target = atol(optarg);
+			break;
+		case 'r':
+			realloc_frac = atof(optarg);
+			break;
+		case 'S':
+			rng_state ^= strtoull(optarg, NULL, 0) * 0xD1B54A32D192ED03ull;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1)
+		usage();
+	if (num_ops < 2 || num_ops > 0x7fffffffL)
+		gen_error("-n must be between 2 and 2^31-1", NULL);
+	if (num_sizes == 0)
+		parse_dist(&sizes[num_sizes++], "pow:16:4096:1.2");
+	if (num_lifes == 0)
+		parse_dist(&lifes[num_lifes++], "exp:1000");
+	if (phase_len <= 0)
+		phase_len = num_ops;
+
+	/* A live set can never exceed the requests still to come */
+	if ((live = malloc((num_ops / 2 + 1) * sizeof(live_t))) == NULL ||
+		(free_ids = malloc((num_ops / 2 + 1) * sizeof(int))) == NULL)
+		gen_error("out of memory", NULL);
+
+	path = argv[optind];
+	len = strlen(path);
+	memset(&out, 0, sizeof(out));
+	out.binary = (len > 4 && strcmp(path + len - 4, ".bin") == 0);
+	if ((out.fp = fopen(path, "wb")) == NULL)
+		gen_error("could not create", path);
+	write_header(&out); /* placeholder, rewritten at the end */
+
+	for (t = 0; out.num_ops + num_live < num_ops; t++)
+	{
+		int phase = (int)(t / phase_len);
+		dist_t *sd = &sizes[phase % num_sizes];
+		dist_t *ld = &lifes[phase % num_lifes];
+
+		if (num_live > 0 && (live[0].death <= t ||
+							 (target > 0 && out.live_bytes >= target)))
+		{
+			live_t b = live_pop();
+			emit(&out, FREE, b.id, b.size);
+			free_ids[num_free_ids++] = b.id;
+		}
+		else if (num_live > 0 && rnd() < realloc_frac)
+		{
+			/* Resize a random live block; its death time stays */
+			live_t *b = &live[(int)(rnd() * num_live)];
+			int size = (int)draw(sd);
+			out.live_bytes -= b->size;
+			b->size = size;
+			emit(&out, REALLOC, b->id, size);
+		}
+		else
+		{
+			live_t b;
+			b.id = num_free_ids > 0 ? free_ids[--num_free_ids] : out.num_ids++;
+			b.size = (int)draw(sd);
+			b.death = t + draw(ld);
+			emit(&out, ALLOC, b.id, b.size);
+			live_push(b);
+		}
+	}
+
+	/* Free everything still live, in order of death */
+	while (num_live > 0)
+	{
+		live_t b = live_pop();
+		emit(&out, FREE, b.id, b.size);
+	}
+
+	write_header(&out);
+	if (fclose(out.fp) != 0)
+		gen_error("write failed", path);
+	printf("%s: %ld ops, %d ids, peak live payload %ld bytes\n",
+		   path, out.num_ops, out.num_ids, out.peak_bytes);
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: gentrace [-n <ops>] [-s <dist>]... [-l <dist>]... [-p <ops>]\n"
+					"                [-L <bytes>] [-r <frac>] [-S <seed>] <out.rep|out.bin>\n");
+	fprintf(stderr, "Options\n");
+	fprintf(stderr, "\t-n <ops>    Total requests (default 100000).\n");
+	fprintf(stderr, "\t-s <dist>   Size distribution; repeat for phases (default pow:16:4096:1.2).\n");
+	fprintf(stderr, "\t-l <dist>   Lifetime in requests; repeat for phases (default exp:1000).\n");
+	fprintf(stderr, "\t-p <ops>    Requests per phase (default: one phase).\n");
+	fprintf(stderr, "\t-L <bytes>  Free early to hold the live payload near this target.\n");
+	fprintf(stderr, "\t-r <frac>   Fraction of requests that realloc a live block.\n");
+	fprintf(stderr, "\t-S <seed>   Random seed.\n");
+	fprintf(stderr, "Distributions: uni:<lo>:<hi> pow:<lo>:<hi>:<alpha> bi:<a>:<b>:<p>\n"
+					"               exp:<mean> hist:<file>\n");
+	exit(1);
+}
+
+static void gen_error(char *msg, char *arg)
+{
+	if (arg != NULL)
+		fprintf(stderr, "gentrace: %s: %s\n", msg, arg);
+	else
+		fprintf(stderr, "gentrace: %s\n", msg);
+	exit(1);
+}
+
+/*
+ * rnd - Uniform double in [0, 1) from a xorshift64* generator
+ */
+static double rnd(void)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return ((rng_state * 0x2545F4914F6CDD1Dull) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * parse_dist - Fill in d from a "kind:args" specification
+ */
+static void parse_dist(dist_t *d, char *spec)
+{
+	memset(d, 0, sizeof(*d));
+	if (sscanf(spec, "uni:%lf:%lf", &d->a, &d->b) == 2)
+		d->kind = DIST_UNI;
+	else if (sscanf(spec, "pow:%lf:%lf:%lf", &d->a, &d->b, &d->c) == 3)
+		d->kind = DIST_POW;
+	else if (sscanf(spec, "bi:%lf:%lf:%lf", &d->a, &d->b, &d->c) == 3)
+		d->kind = DIST_BI;
+	else if (sscanf(spec, "exp:%lf", &d->a) == 1)
+		d->kind = DIST_EXP;
+	else if (strncmp(spec, "hist:", 5) == 0)
+	{
+		d->kind = DIST_HIST;
+		read_hist(d, spec + 5);
+		return;
+	}
+	else
+		gen_error("bad distribution", spec);
+
+	if (d->a < 1 || (d->kind != DIST_EXP && d->kind != DIST_BI && d->b < d->a) ||
+		(d->kind == DIST_BI && (d->b < 1 || d->c < 0 || d->c > 1)) ||
+		(d->kind == DIST_POW && d->c <= 0))
+		gen_error("distribution parameters out of range", spec);
+}
+
+/*
+ * read_hist - Load "<value> <weight>" lines and build the cumulative
+ *     weights that draw() searches
+ */
+static void read_hist(dist_t *d, char *path)
+{
+	FILE *fp;
+	long value;
+	double weight, sum = 0;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		gen_error("could not open histogram", path);
+	d->hist_val = malloc(MAX_HIST * sizeof(long));
+	d->hist_cum = malloc(MAX_HIST * sizeof(double));
+	if (d->hist_val == NULL || d->hist_cum == NULL)
+		gen_error("out of memory", NULL);
+	while (fscanf(fp, "%ld %lf", &value, &weight) == 2)
+	{
+		if (d->hist_n == MAX_HIST)
+			gen_error("too many histogram entries", path);
+		if (value < 1 || weight < 0)
+			gen_error("bad histogram entry", path);
+		sum += weight;
+		d->hist_val[d->hist_n] = value;
+		d->hist_cum[d->hist_n++] = sum;
+	}
+	fclose(fp);
+	if (d->hist_n == 0 || sum <= 0)
+		gen_error("empty histogram", path);
+}
+
+/*
+ * draw - One sample of d, at least 1 and at most MAX_SIZE
+ */
+static long draw(dist_t *d)
+{
+	double u = rnd(), x;
+	int lo, hi;
+
+	switch (d->kind)
+	{
+	case DIST_UNI:
+		x = d->a + u * (d->b - d->a + 1);
+		break;
+	case DIST_POW:
+		/* inverse CDF of the Pareto distribution truncated to [a, b] */
+		x = pow(pow(d->a, -d->c) - u * (pow(d->a, -d->c) - pow(d->b, -d->c)),
+				-1.0 / d->c);
+		break;
+	case DIST_BI:
+		x = (u < d->c) ? d->a : d->b;
+		break;
+	case DIST_EXP:
+		x = 1 - d->a * log(1 - u);
+		break;
+	default: /* DIST_HIST: first entry whose cumulative weight exceeds u */
+		u *= d->hist_cum[d->hist_n - 1];
+		for (lo = 0, hi = d->hist_n - 1; lo < hi;)
+		{
+			int mid = (lo + hi) / 2;
+			if (d->hist_cum[mid] <= u)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		x = d->hist_val[lo];
+		break;
+	}
+	if (x < 1)
+		return 1;
+	return (x > MAX_SIZE) ? MAX_SIZE : (long)x;
+}
+
+/*
+ * live_push, live_pop, live_sift_down - Min-heap of live blocks
+ *     ordered by time of death
+ */
+static void live_push(live_t b)
+{
+	int i = num_live++;
+
+	while (i > 0 && live[(i - 1) / 2].death > b.death)
+	{
+		live[i] = live[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	live[i] = b;
+}
+
+static live_t live_pop(void)
+{
+	live_t top = live[0];
+
+	live[0] = live[--num_live];
+	live_sift_down(0);
+	return top;
+}
+
+static void live_sift_down(int i)
+{
+	live_t b = live[i];
+
+	for (;;)
+	{
+		int child = 2 * i + 1;
+		if (child >= num_live)
+			break;
+		if (child + 1 < num_live && live[child + 1].death < live[child].death)
+			child++;
+		if (live[child].death >= b.death)
+			break;
+		live[i] = live[child];
+		i = child;
+	}
+	live[i] = b;
+}
+
+/*
+ * emit - Append one request to the trace and track the live payload
+ */
+static void emit(out_t *out, int type, int id, int size)
+{
+	traceop_t op;
+
+	if (type == FREE)
+		out->live_bytes -= size;
+	else
+		out->live_bytes += size;
+	if (out->live_bytes > out->peak_bytes)
+		out->peak_bytes = out->live_bytes;
+	out->num_ops++;
+
+	if (out->binary)
+	{
+		memset(&op, 0, sizeof(op));
+		op.type = type;
+		op.index = id;
+		op.size = (type == FREE) ? 0 : size;
+		if (fwrite(&op, sizeof(op), 1, out->fp) != 1)
+			gen_error("write failed", NULL);
+	}
+	else if (type == FREE)
+		fprintf(out->fp, "f %d\n", id);
+	else
+		fprintf(out->fp, "%c %d %d\n", type == ALLOC ? 'a' : 'r', id, size);
+}
+
+/*
+ * write_header - Write the trace header at the start of the file; the
+ *     .rep fields are padded to a fixed width so the final header can
+ *     overwrite the placeholder in place
+ */
+static void write_header(out_t *out)
+{
+	tracehdr_t hdr;
+	long heap = out->peak_bytes > 0x7fffffffL ? 0x7fffffffL : out->peak_bytes;
+
+	rewind(out->fp);
+	if (out->binary)
+	{
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, TRACE_MAGIC, TRACE_MAGIC_LEN);
+		hdr.sugg_heapsize = (int)heap;
+		hdr.num_ids = out->num_ids;
+		hdr.num_ops = (int)out->num_ops;
+		hdr.weight = 1;
+		hdr.op_size = sizeof(traceop_t);
+		if (fwrite(&hdr, sizeof(hdr), 1, out->fp) != 1)
+			gen_error("write failed", NULL);
+	}
+	else
+		fprintf(out->fp, "%-*ld\n%-*d\n%-*ld\n%-*d\n",
+				REP_HDR_WIDTH, heap, REP_HDR_WIDTH, out->num_ids,
+				REP_HDR_WIDTH, out->num_ops, REP_HDR_WIDTH, 1);
+	fseek(out->fp, 0, SEEK_END);
+}
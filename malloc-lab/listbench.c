@@ -0,0 +1,191 @@
+/*
+ * listbench.c - Time mm.c's free-list scans, in cycles per list node
+ *
+ * Usage: listbench [-n <nodes>] [-g <bytes>] [-r <reps>] [-e <MB>] [-S <seed>]
+ *
+ * Builds a heap whose free blocks all sit in one size class, each
+ * between two allocated blocks of random size (up to -g bytes) so that
+ * consecutive list nodes lie on different pages with no fixed stride
+ * for the hardware prefetchers to follow. The only block that fits the probe request
+ * exactly is the last one in address order, so every mm_malloc of the
+ * probe walks the whole list in find_fit (best fit), and every mm_free
+ * of it walks the whole list again in insert_addr. Before each walk a
+ * buffer larger than the caches is written, so the nodes come from
+ * memory. Build it with and without PREFETCH=1 to compare:
+ *
+ *	unix> make listbench && ./listbench
+ *	unix> make clean && make listbench PREFETCH=1 && ./listbench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "clock.h"
+
+#define NODE_SIZE 252	/* payload of a list node (256 or 264-byte block) */
+#define PROBE_SIZE 300	/* larger, in the same size class (256-319 bytes) */
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ull;
+
+static void usage(void);
+static void bench_error(char *msg);
+static unsigned rnd(void);
+static void evict(char *buf, size_t len);
+static unsigned long long cycles(void);
+static int cmp_ull(const void *a, const void *b);
+
+int main(int argc, char **argv)
+{
+	int c, i;
+	int n = 2000, gap = 8192, reps = 11;
+	size_t evict_len = 256 << 20;
+	char *buf, *probe;
+	void **nodes;
+	unsigned long long t, *fit, *ins;
+	mm_params_t params;
+
+	while ((c = getopt(argc, argv, "n:g:r:e:S:h")) != EOF)
+		switch (c)
+		{
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 'g':
+			gap = atoi(optarg);
+			break;
+		case 'r':
+			reps = atoi(optarg);
+			break;
+		case 'e':
+			evict_len = (size_t)atoi(optarg) << 20;
+			break;
+		case 'S':
+			rng_state = strtoull(optarg, NULL, 0) | 1;
+			break;
+		case 'h':
+			usage();
+			exit(0);
+		default:
+			usage();
+			exit(1);
+		}
+	if (n < 1 || gap < 16 || reps < 1 || evict_len == 0)
+		bench_error("-n, -r and -e must be positive, -g at least 16");
+
+	nodes = malloc(n * sizeof(void *));
+	fit = malloc(reps * sizeof(unsigned long long));
+	ins = malloc(reps * sizeof(unsigned long long));
+	if (nodes == NULL || fit == NULL || ins == NULL ||
+		(buf = malloc(evict_len)) == NULL)
+		bench_error("out of memory");
+
+	mem_init();
+	if (mm_init() < 0)
+		bench_error("mm_init failed");
+	if (mm_set_policy("best") < 0)
+		bench_error("this build has no best-fit policy");
+	mm_get_params(&params);
+	params.hot_list_max = 0; /* keep the probe out of the quick lists */
+	if (mm_set_params(&params) < 0)
+		bench_error("mm_set_params failed");
+
+	/* node, gap, node, gap, ..., probe, gap */
+	for (i = 0; i < n; i++)
+	{
+		if ((nodes[i] = mm_malloc(NODE_SIZE)) == NULL ||
+			mm_malloc(16 + rnd() % (gap - 15)) == NULL)
+			bench_error("heap too small; lower -n or build with MEMLIB=MMAP");
+	}
+	if ((probe = mm_malloc(PROBE_SIZE)) == NULL || mm_malloc(16) == NULL)
+		bench_error("heap too small; lower -n or build with MEMLIB=MMAP");
+
+	/* Free from the top down, so each insert lands at the list head */
+	mm_free(probe);
+	for (i = n - 1; i >= 0; i--)
+		mm_free(nodes[i]);
+
+	for (i = 0; i < reps; i++)
+	{
+		evict(buf, evict_len);
+		t = cycles();
+		probe = mm_malloc(PROBE_SIZE);
+		fit[i] = cycles() - t;
+		if (probe == NULL)
+			bench_error("mm_malloc of the probe failed");
+
+		evict(buf, evict_len);
+		t = cycles();
+		mm_free(probe);
+		ins[i] = cycles() - t;
+	}
+
+	qsort(fit, reps, sizeof(unsigned long long), cmp_ull);
+	qsort(ins, reps, sizeof(unsigned long long), cmp_ull);
+	printf("%d nodes, %d reps (median, min cycles per node)\n", n, reps);
+	printf("%-12s%10.1f%10.1f\n", "find_fit",
+		   (double)fit[reps / 2] / n, (double)fit[0] / n);
+	printf("%-12s%10.1f%10.1f\n", "insert_addr",
+		   (double)ins[reps / 2] / n, (double)ins[0] / n);
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: listbench [-n <nodes>] [-g <bytes>] [-r <reps>] [-e <MB>] [-S <seed>]\n");
+	fprintf(stderr, "Options\n");
+	fprintf(stderr, "\t-n <nodes>  Free blocks in the scanned list (default 2000).\n");
+	fprintf(stderr, "\t-g <bytes>  Largest allocated block between two nodes (default 8192).\n");
+	fprintf(stderr, "\t-r <reps>   Timed scans of each kind (default 11).\n");
+	fprintf(stderr, "\t-e <MB>     Bytes written between scans to empty the caches (default 256).\n");
+	fprintf(stderr, "\t-S <seed>   Random seed for the gaps between nodes.\n");
+}
+
+static void bench_error(char *msg)
+{
+	fprintf(stderr, "listbench: %s\n", msg);
+	exit(1);
+}
+
+/*
+ * rnd - xorshift64*, enough for scattering the gaps
+ */
+static unsigned rnd(void)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return (unsigned)((rng_state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+/*
+ * evict - Write len bytes of buf, pushing the heap out of the caches
+ */
+static void evict(char *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i += 64)
+		buf[i]++;
+}
+
+/*
+ * cycles - Current value of the cycle counter
+ */
+static unsigned long long cycles(void)
+{
+	unsigned hi, lo;
+
+	access_counter(&hi, &lo);
+	return ((unsigned long long)hi << 32) | lo;
+}
+
+static int cmp_ull(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return (x > y) - (x < y);
+}
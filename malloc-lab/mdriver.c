@@ -14,14 +14,29 @@
 #include <string.h>
 #include <assert.h>
 #include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sched.h>
 
 extern char *optarg; // Added declaration for optarg
 
 #include "mm.h"
 #include "memlib.h"
 #include "fsecs.h"
+#include "ftimer.h"
+#include "clock.h"
 #include "config.h"
+#include "trace.h"
 
 /**********************
  * Constants and macros
@@ -39,26 +54,27 @@ extern char *optarg; // Added declaration for optarg
  * The key compound data types
  *****************************/
 
-/* Records the extent of each block's payload */
+/*
+ * Records the extent of each block's payload. The live payloads of a
+ * trace form a splay tree keyed by lo; payloads never overlap, so the
+ * tree is also ordered by hi.
+ */
 typedef struct range_t
 {
-	char *lo;			  /* low payload address */
-	char *hi;			  /* high payload address */
-	struct range_t *next; /* next list element */
+	char *lo;			   /* low payload address */
+	char *hi;			   /* high payload address */
+	struct range_t *left;  /* payloads below lo */
+	struct range_t *right; /* payloads above hi */
 } range_t;
 
-/* Characterizes a single trace operation (allocator request) */
-typedef struct
+/* Range records are carved out of chunks instead of malloc'd one by one */
+#define RANGE_CHUNK 4096 /* range records per chunk */
+
+typedef struct range_chunk_t
 {
-	enum
-	{
-		ALLOC,
-		FREE,
-		REALLOC
-	} type;	   /* type of request */
-	int index; /* index for free() to use later */
-	int size;  /* byte size of alloc/realloc request */
-} traceop_t;
+	struct range_chunk_t *next;	 /* previously allocated chunk */
+	range_t nodes[RANGE_CHUNK];
+} range_chunk_t;
 
 /* Holds the information for one trace file*/
 typedef struct
@@ -70,8 +86,68 @@ typedef struct
 	traceop_t *ops;		 /* array of requests */
 	char **blocks;		 /* array of ptrs returned by malloc/realloc... */
 	size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+	void *map;			 /* mmap'd binary trace backing ops, or NULL */
+	size_t map_len;		 /* length of that mapping */
 } trace_t;
 
+/*
+ * With -m, runs of consecutive mallocs of one size and runs of
+ * consecutive frees go to mm_malloc_batch / mm_free_batch, at most
+ * BATCH_MAX requests per call
+ */
+#define BATCH_MAX 64
+
+/*
+ * A streamed trace (-r) is read in blocks of STREAM_OPS requests
+ * instead of being loaded. A reader thread fills one buffer while the
+ * replay works through the other, so the driver touches only two
+ * small buffers however long the trace is, and the buffers stay small
+ * enough not to crowd the allocator out of the cache.
+ */
+#define STREAM_OPS 4096 /* requests per buffer (48 KB) */
+
+typedef struct
+{
+	FILE *fp;
+	int binary;			   /* binary trace (trace.h) or .rep text */
+	long num_ops;		   /* requests promised by the header */
+	long num_read;		   /* requests parsed so far by the reader */
+	traceop_t *buf[2];	   /* the two buffers */
+	int count[2];		   /* requests in each filled buffer, 0 at the end */
+	int filled[2];		   /* buffer is ready for the replay */
+	int cur;			   /* buffer the replay is working through */
+	int pos, len;		   /* next request in it, and its request count */
+	int held;			   /* the replay owns buf[cur] */
+	int stop;			   /* asks the reader to quit early */
+	char error[MAXLINE];   /* what the reader choked on, or "" */
+	double waited;		   /* seconds the replay spent blocked in stream_next */
+	pthread_t reader;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} stream_t;
+
+/* One live block of a streamed trace */
+typedef struct
+{
+	int id;	 /* trace id, or -1 for an empty slot */
+	int size; /* payload size */
+	char *p;  /* payload address */
+} idslot_t;
+
+/*
+ * Maps the ids of a streamed trace to their live blocks. Open
+ * addressing with linear probing and backward-shift deletion, so the
+ * table grows with the live set rather than with num_ids.
+ */
+typedef struct
+{
+	idslot_t *slots;
+	unsigned mask;	/* capacity - 1, capacity is a power of two */
+	unsigned count; /* live ids */
+} idmap_t;
+
+#define IDMAP_MIN 1024 /* initial capacity */
+
 /*
  * Holds the params to the xxx_speed functions, which are timed by fcyc.
  * This struct is necessary because fcyc accepts only a pointer array
@@ -81,8 +157,88 @@ typedef struct
 {
 	trace_t *trace;
 	range_t *ranges;
+	char *path;		 /* tracefile streamed by eval_mm_stream_speed */
+	double io_secs;	 /* ... and its seconds spent in I/O, over all calls */
+	int io_calls;	 /* number of those calls */
 } speed_t;
 
+#ifdef THREAD_CACHE
+/*
+ * In the hand-off replay each thread passes the blocks its trace frees
+ * to its neighbour through a single-producer, single-consumer ring,
+ * and the neighbour frees them: thread t frees what thread t+1
+ * allocated, which sends every free down mm.c's remote free path.
+ */
+#define HANDOFF_SLOTS 1024 /* ring capacity, a power of two */
+
+typedef struct
+{
+	char *slots[HANDOFF_SLOTS];
+	unsigned long head; /* next slot to free; written by the consumer */
+	unsigned long tail; /* next slot to fill; written by the producer */
+	int done;			/* the producer has finished its replay */
+} handoff_t;
+
+/*
+ * Holds the params to eval_mm_mt_speed, which replays one trace on
+ * several threads at once against the same heap. Each thread keeps
+ * its own array of block pointers blocks[t]. rings is NULL when every
+ * thread frees its own blocks, else one hand-off ring per thread.
+ */
+typedef struct
+{
+	trace_t *trace;
+	int num_threads;
+	char ***blocks;
+	handoff_t *rings;
+} mt_speed_t;
+
+/* The argument of each replay thread */
+typedef struct
+{
+	trace_t *trace;
+	char **blocks;
+	handoff_t *out; /* ring this thread fills (NULL: free its own blocks) */
+	handoff_t *in;	/* ring of the next thread, whose blocks it frees */
+} mt_replay_t;
+#endif
+
+/*
+ * Per-op latency histograms filled in by the instrumented replay (-L).
+ * Cycle counts are log-bucketed HDR style: values below 2*LAT_SUB get
+ * their own bucket, and every power of two above that is split into
+ * LAT_SUB linear buckets, so a reported percentile is never more than
+ * 1/LAT_SUB above the true one.
+ */
+#define LAT_OPS 3	   /* ALLOC, FREE, REALLOC */
+#define LAT_SIZES 5	   /* request size classes, see lat_size_names */
+#define LAT_SUB_BITS 3 /* log2 of buckets per power of two */
+#define LAT_SUB (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS ((65 - LAT_SUB_BITS) * LAT_SUB)
+
+typedef struct
+{
+	unsigned long long count[LAT_OPS][LAT_SIZES]; /* ops timed */
+	unsigned long long max[LAT_OPS][LAT_SIZES];	  /* slowest op, exact */
+	unsigned long long hist[LAT_OPS][LAT_SIZES][LAT_BUCKETS];
+} latency_t;
+
+/*
+ * dTLB behaviour of one extra timed replay of a trace (-d). The counts
+ * come from perf_event_open and cover user-mode data loads of the
+ * replay only; a counter the CPU (or the VM) does not offer is left
+ * at -1. huge_bytes is the process's memory on hugepages right after
+ * the replay (transparent and hugetlbfs), i.e. how much of the heap
+ * the kernel backed with 2 MB pages.
+ */
+typedef struct
+{
+	long long loads;	  /* dTLB read accesses */
+	long long misses;	  /* dTLB read misses */
+	double secs;		  /* time of the counted replay */
+	size_t huge_bytes;	  /* hugepage memory after it */
+} tlb_t;
+
 /* Summarizes the important stats for some malloc function on some trace */
 typedef struct
 {
@@ -93,17 +249,114 @@ typedef struct
 
 	/* defined only for the student malloc package */
 	double util; /* space utilization for this trace (always 0 for libc) */
+	size_t peak_heap;  /* largest heap during the util run */
+	size_t final_heap; /* heap bytes still resident at the end of it */
+	latency_t *lat;	   /* per-op latencies, or NULL without -L */
+	tlb_t tlb;		   /* dTLB counters (with -d) */
+	double batch_secs; /* secs of the batched replay (with -m) */
 
 	/* Note: secs and util are only defined if valid is true */
 } stats_t;
 
+/*
+ * Result slot of one trace in the parallel runner (-J), kept in memory
+ * shared with the worker process that runs the trace
+ */
+typedef struct
+{
+	stats_t stats;	/* stats.lat is not valid here, see lat */
+	int errors;		/* errors the worker found */
+	int done;		/* set by the worker once stats is filled in */
+	latency_t lat;	/* copy of the worker's latencies (with -L) */
+} job_t;
+
+/*
+ * The tuner (-u) searches these mm_params_t fields, trying the listed
+ * values of one field at a time. Values that mm_set_params rejects in
+ * this build are skipped.
+ */
+#define TUNE_VALUES 8
+#define TUNE_ROUNDS 3 /* max passes over all fields */
+typedef struct
+{
+	char *name;
+	size_t offset; /* offsetof(mm_params_t, name) */
+	int num_values;
+	size_t values[TUNE_VALUES];
+} tune_param_t;
+
+#define PARAM(p, k) (*(size_t *)((char *)(p) + tune_table[k].offset))
+
+/*
+ * Benchmark mode (-b): each trace is replayed in reps rounds, round
+ * robin over the traces so that slow drifts of the machine spread over
+ * all of them. A throughput sample is the mean of BENCH_RUNS replays
+ * timed with the monotonic clock. A result is the median of its
+ * samples with a distribution-free 95% confidence interval: the order
+ * statistics at ranks (reps -/+ 1.96 sqrt(reps)) / 2.
+ *
+ * Against a baseline (-B) a trace regresses when its interval lies
+ * entirely below the baseline's and its median dropped by more than
+ * the tolerance, so noise alone does not fail the comparison.
+ */
+#define BENCH_RUNS 10				/* replays per throughput sample */
+#define BENCH_TOLERANCE 0.02		/* Kops drops up to 2% are not regressions */
+#define BENCH_UTIL_TOLERANCE 0.001	/* nor util drops up to 0.1 points */
+
+typedef struct
+{
+	double median;
+	double lo, hi; /* 95% confidence interval of the median */
+} interval_t;
+
+typedef struct
+{
+	char name[MAXLINE]; /* tracefile, or "total" for the whole set */
+	long ops;			/* requests per replay */
+	interval_t kops;	/* thousands of requests per second */
+	interval_t util;	/* space utilization, 0 to 1 */
+} bench_t;
+
 /********************
  * Global variables
  *******************/
 int verbose = 0;	   /* global flag for verbose output */
 static int errors = 0; /* number of errs found when running student malloc */
+static int stream_traces = 0; /* stream traces instead of loading them (-r) */
+static int tlb_report = 0;	  /* count dTLB misses of each trace (-d) */
+static int batch_mode = 0;	  /* serve same-size runs through the batch calls (-m) */
 char msg[MAXLINE];	   /* for whenever we need to compose an error message */
 
+/* Pool of range records: a free list backed by a chain of chunks */
+static range_chunk_t *range_chunks = NULL; /* chunks handed out so far */
+static int range_chunk_used = RANGE_CHUNK; /* records used in range_chunks */
+static range_t *range_free = NULL;		   /* recycled records (via right) */
+
+/* Row labels of the latency table */
+static char *lat_op_names[LAT_OPS] = {"malloc", "free", "realloc"};
+static char *lat_size_names[LAT_SIZES] = {"<=64", "<=512", "<=4K", "<=32K", ">32K"};
+
+/* Search space of the tuner */
+static tune_param_t tune_table[] = {
+	{"chunk_size", offsetof(mm_params_t, chunk_size), 7,
+	 {64, 128, 256, 512, 1024, 4096, 16384}},
+	{"split_min", offsetof(mm_params_t, split_min), 7,
+	 {16, 24, 32, 48, 64, 96, 128}},
+	{"split_high", offsetof(mm_params_t, split_high), 8,
+	 {0, 64, 96, 112, 128, 192, 256, 512}},
+	{"hot_min_count", offsetof(mm_params_t, hot_min_count), 5,
+	 {8, 16, 32, 64, 128}},
+	{"hot_cold_count", offsetof(mm_params_t, hot_cold_count), 5,
+	 {0, 2, 4, 8, 16}},
+	{"hot_window", offsetof(mm_params_t, hot_window), 5,
+	 {256, 512, 1024, 2048, 4096}},
+	{"hot_list_max", offsetof(mm_params_t, hot_list_max), 5,
+	 {0, 16, 64, 128, 512}},
+	{"trim_threshold", offsetof(mm_params_t, trim_threshold), 4,
+	 {1 << 17, 1 << 18, 1 << 20, 1 << 24}},
+};
+#define TUNE_PARAMS (int)(sizeof(tune_table) / sizeof(tune_table[0]))
+
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
@@ -115,16 +368,31 @@ static char *default_tracefiles[] = {
  * Function prototypes
  *********************/
 
-/* these functions manipulate range lists */
+/* these functions manipulate range trees */
 static int add_range(range_t **ranges, char *lo, int size,
 					 int tracenum, int opnum);
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
+static range_t *splay_range(range_t *t, char *lo);
+static range_t *new_range(void);
 
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(char *tracedir, char *filename);
+static int map_trace(trace_t *trace, char *path);
 static void free_trace(trace_t *trace);
 
+/* These functions stream a trace through a reader thread (-r) */
+static stream_t *stream_open(char *path);
+static traceop_t *stream_next(stream_t *s);
+static void stream_close(stream_t *s);
+static double mono_secs(void);
+static void *stream_reader(void *ptr);
+static int stream_fill(stream_t *s, traceop_t *buf);
+static void idmap_init(idmap_t *m);
+static idslot_t *idmap_insert(idmap_t *m, int id);
+static idslot_t *idmap_get(idmap_t *m, int id);
+static void idmap_remove(idmap_t *m, idslot_t *slot);
+
 /* Routines for evaluating the correctness and speed of libc malloc */
 static int eval_libc_valid(trace_t *trace, int tracenum);
 static void eval_libc_speed(void *ptr);
@@ -132,11 +400,68 @@ static void eval_libc_speed(void *ptr);
 /* Routines for evaluating correctnes, space utilization, and speed
    of the student's malloc package in mm.c */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
+static int eval_mm_huge(int tracenum, int opnum);
+static int eval_mm_sized(trace_t *trace, int tracenum, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
 static void eval_mm_speed(void *ptr);
+static int batch_run(trace_t *trace, int i);
+static int eval_mm_batch(trace_t *trace, int tracenum, range_t **ranges, int i, int n);
+static void eval_mm_batch_speed(void *ptr);
+static latency_t *eval_mm_latency(trace_t *trace);
+static void eval_mm_tlb(speed_t *speed_params, tlb_t *tlb);
+static int tlb_counter(unsigned long long config);
+static long long tlb_read(int fd);
+static size_t huge_resident(void);
+static int eval_mm_stream_valid(char *path, int tracenum, range_t **ranges);
+static double eval_mm_stream_util(char *path);
+static void eval_mm_stream_speed(void *ptr);
+#ifdef THREAD_CACHE
+static void eval_mm_mt_speed(void *ptr);
+static void *mt_replay(void *ptr);
+static void handoff_put(mt_replay_t *arg, char *p);
+static int handoff_drain(handoff_t *ring);
+static void eval_mm_threads(char **tracefiles, int num_tracefiles, int max_threads);
+#endif
+
+/* Routines for running the mm traces, one after another or in worker processes */
+static void eval_mm_trace(char *tracename, int tracenum, range_t **ranges,
+						  stats_t *st, int latency, FILE *stats_fp,
+						  FILE *layout_fp, int layout_every);
+static void eval_mm_parallel(char **tracefiles, int num_tracefiles, int jobs,
+							 int latency, stats_t *mm_stats);
+
+/* Routines for tuning mm.c's run-time parameters */
+static double perf_index(double util, double throughput, double *p1, double *p2);
+static double eval_mm_perfindex(trace_t **traces, int n, range_t **ranges);
+static void tune_params(char **tracefiles, int num_tracefiles, char *path);
+static void read_params(char *path);
+static void write_params(FILE *fp, mm_params_t *params);
+
+/* Routines for the benchmark mode */
+static int bench_traces(char **tracefiles, int num_tracefiles, int reps,
+						char *out_path, char *base_path);
+static interval_t median_ci(double *x, int n);
+static int cmp_double(const void *a, const void *b);
+static void write_bench(char *path, bench_t *b, int n, int reps);
+static void json_string(FILE *fp, const char *str);
+static char *json_unstring(char *p, char *out);
+static int read_bench(char *path, bench_t **b);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void printheap(int n, stats_t *stats);
+static void printlatency(int n, stats_t *stats);
+static void printtlb(int n, stats_t *stats);
+static void printbatch(int n, stats_t *stats);
+#ifdef MM_STATS
+static void dump_mm_stats(FILE *fp, char *tracename);
+static void dump_json_array(FILE *fp, char *name, unsigned long *v, int n);
+static void eval_mm_layout(trace_t *trace, char *tracename, FILE *fp, int every);
+static void layout_snapshot(FILE *fp, char *tracename, int opnum, long payload);
+#endif
+static unsigned long long lat_percentile(unsigned long long *hist,
+										 unsigned long long count,
+										 unsigned long long max, double q);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -160,6 +485,17 @@ int main(int argc, char **argv)
 	int team_check = 1; /* If set, check team structure (reset by -a) */
 	int run_libc = 0;	/* If set, run libc malloc (set by -l) */
 	int autograder = 0; /* If set, emit summary info for autograder (-g) */
+	int max_threads = 0; /* If set, run the multithreaded replay (-T) */
+	int latency = 0;	 /* If set, time every request (set by -L) */
+	FILE *stats_fp = NULL; /* If set, dump mm_stats() here (set by -j) */
+	FILE *layout_fp = NULL; /* If set, write heap snapshots here (set by -s) */
+	int layout_every = 1000; /* ops between two snapshots (set by -S) */
+	char *tune_path = NULL; /* If set, tune mm.c and write the result here (-u) */
+	int jobs = 1; /* worker processes running traces at once (set by -J) */
+	int bench_reps = 0;	   /* If set, benchmark every trace this often (-b) */
+	char *bench_out = NULL;	   /* If set, write the benchmark here (-o) */
+	char *bench_base = NULL;  /* If set, compare the benchmark with it (-B) */
+	int regressions = 0;	   /* results worse than the baseline's */
 
 	/* temporaries used to compute the performance index */
 	double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
@@ -168,7 +504,7 @@ int main(int argc, char **argv)
 	/*
 	 * Read and interpret the command line arguments
 	 */
-	while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF)
+	while ((c = getopt(argc, argv, "f:t:hvVgadlLmb:B:c:j:J:o:rs:S:P:p:u:T:")) != EOF)
 	{
 		printf("getopt returned: %d\n", c); // 디버깅용 출력 추가
 
@@ -195,15 +531,100 @@ int main(int argc, char **argv)
 		case 'a': /* Don't check team structure */
 			team_check = 0;
 			break;
+		case 'd': /* Count dTLB misses of each trace with perf counters */
+			tlb_report = 1;
+			break;
 		case 'l': /* Run libc malloc */
 			run_libc = 1;
 			break;
+		case 'L': /* Report per-request latency percentiles */
+			latency = 1;
+			break;
+		case 'm': /* Serve same-size runs of requests through the batch calls */
+			batch_mode = 1;
+			break;
+		case 'b': /* Benchmark: replay every trace in n timed rounds */
+			bench_reps = atoi(optarg);
+			if (bench_reps < 1)
+				app_error("ERROR: -b needs a round count of at least 1");
+			break;
+		case 'B': /* Compare the benchmark with a file written by -o */
+			bench_base = optarg;
+			break;
+		case 'c': /* Check the heap after every request, or 1 in n */
+#ifndef MM_CHECK
+			app_error("ERROR: -c needs a CHECK=1 build of mm.c");
+#else
+			if (!strcmp(optarg, "full"))
+				mm_set_check(MM_CHECK_FULL, 1);
+			else if (!strcmp(optarg, "incr"))
+				mm_set_check(MM_CHECK_INCR, 1);
+			else if (atoi(optarg) >= 1)
+				mm_set_check(MM_CHECK_SAMPLE, atoi(optarg));
+			else
+				app_error("ERROR: -c takes full, incr or an interval n >= 1");
+#endif
+			break;
+		case 'j': /* Dump allocator-internal stats of each trace as JSON */
+#ifndef MM_STATS
+			app_error("ERROR: -j needs a STATS=1 build of mm.c");
+#endif
+			if ((stats_fp = fopen(optarg, "w")) == NULL)
+				unix_error("ERROR: could not open the -j file");
+			break;
+		case 'J': /* Run up to n traces at once in worker processes */
+			jobs = atoi(optarg);
+			if (jobs < 1)
+				app_error("ERROR: -J needs a job count of at least 1");
+			break;
+		case 'o': /* Write the benchmark results as JSON, or CSV for *.csv */
+			bench_out = optarg;
+			break;
+		case 'r': /* Stream the traces from disk instead of loading them */
+			stream_traces = 1;
+			break;
+		case 's': /* Write heap-layout snapshots of each trace as CSV */
+#ifndef MM_STATS
+			app_error("ERROR: -s needs a STATS=1 build of mm.c");
+#endif
+			if ((layout_fp = fopen(optarg, "w")) == NULL)
+				unix_error("ERROR: could not open the -s file");
+			break;
+		case 'S': /* Take a heap-layout snapshot every n ops */
+			layout_every = atoi(optarg);
+			if (layout_every < 1)
+				app_error("ERROR: -S needs an interval of at least 1");
+			break;
+		case 'P': /* Select one of mm.c's built-in allocation policies */
+			if (mm_set_policy(optarg) < 0)
+			{
+				fprintf(stderr, "ERROR: unknown policy %s; this build has:", optarg);
+				for (i = 0; mm_policy_name(i) != NULL; i++)
+					fprintf(stderr, " %s", mm_policy_name(i));
+				fprintf(stderr, "\n");
+				exit(1);
+			}
+			break;
+		case 'p': /* Load mm.c parameters written by -u */
+			read_params(optarg);
+			break;
+		case 'u': /* Tune mm.c's parameters on the traces, save the best */
+			tune_path = optarg;
+			break;
 		case 'v': /* Print per-trace performance breakdown */
 			verbose = 1;
 			break;
 		case 'V': /* Be more verbose than -v */
 			verbose = 2;
 			break;
+		case 'T': /* Replay traces concurrently on up to n threads */
+			max_threads = atoi(optarg);
+			if (max_threads < 1)
+				app_error("ERROR: -T needs a thread count of at least 1");
+#ifndef THREAD_CACHE
+			app_error("ERROR: -T needs a THREADS=1 build of mm.c");
+#endif
+			break;
 		case 'h': /* Print this message */
 			usage();
 			exit(0);
@@ -213,6 +634,17 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (jobs > 1 && (stats_fp != NULL || layout_fp != NULL))
+		app_error("ERROR: -j and -s write one file from one process; drop -J");
+	if (stream_traces && (latency || layout_fp != NULL))
+		app_error("ERROR: -L and -s replay a loaded trace; drop -r");
+	if ((bench_out != NULL || bench_base != NULL) && bench_reps == 0)
+		app_error("ERROR: -o and -B write and compare a benchmark; add -b <n>");
+	if (bench_reps > 0 && stream_traces)
+		app_error("ERROR: -b replays loaded traces; drop -r");
+	if (batch_mode && stream_traces)
+		app_error("ERROR: -m replays loaded traces; drop -r");
+
 	/*
 	 * Check and print team info
 	 */
@@ -310,37 +742,61 @@ int main(int argc, char **argv)
 
 	/* Initialize the simulated memory system in memlib.c */
 	mem_init();
+	if (tune_path != NULL)
+		tune_params(tracefiles, num_tracefiles, tune_path);
+	if (stats_fp != NULL)
+		fprintf(stats_fp, "[");
 
 	/* Evaluate student's mm malloc package using the K-best scheme */
-	for (i = 0; i < num_tracefiles; i++)
+	if (jobs > 1)
+		eval_mm_parallel(tracefiles, num_tracefiles, jobs, latency, mm_stats);
+	else
+		for (i = 0; i < num_tracefiles; i++)
+			eval_mm_trace(tracefiles[i], i, &ranges, &mm_stats[i], latency,
+						  stats_fp, layout_fp, layout_every);
+
+	if (stats_fp != NULL)
 	{
-		trace = read_trace(tracedir, tracefiles[i]);
-		mm_stats[i].ops = trace->num_ops;
-		if (verbose > 1)
-			printf("Checking mm_malloc for correctness, ");
-		mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-		if (mm_stats[i].valid)
-		{
-			if (verbose > 1)
-				printf("efficiency, ");
-			mm_stats[i].util = eval_mm_util(trace, i, &ranges);
-			speed_params.trace = trace;
-			speed_params.ranges = ranges;
-			if (verbose > 1)
-				printf("and performance.\n");
-			mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
-		}
-		free_trace(trace);
+		fprintf(stats_fp, "\n]\n");
+		fclose(stats_fp);
 	}
+	if (layout_fp != NULL)
+		fclose(layout_fp);
 
 	/* Display the mm results in a compact table */
 	if (verbose)
 	{
 		printf("\nResults for mm malloc:\n");
 		printresults(num_tracefiles, mm_stats);
+		printf("\nHeap footprint for mm malloc:\n");
+		printheap(num_tracefiles, mm_stats);
+		printf("\n");
+	}
+	if (latency)
+	{
+		printf("Latency for mm malloc (cycles per request):\n");
+		printlatency(num_tracefiles, mm_stats);
+		printf("\n");
+	}
+	if (tlb_report)
+	{
+		printf("dTLB misses for mm malloc (one replay per trace):\n");
+		printtlb(num_tracefiles, mm_stats);
+		printf("\n");
+	}
+	if (batch_mode)
+	{
+		printf("Batched replay for mm malloc (runs of up to %d same-size mallocs or frees per call):\n", BATCH_MAX);
+		printbatch(num_tracefiles, mm_stats);
 		printf("\n");
 	}
 
+#ifdef THREAD_CACHE
+	/* Optionally measure how throughput scales with the number of threads */
+	if (max_threads > 0)
+		eval_mm_threads(tracefiles, num_tracefiles, max_threads);
+#endif
+
 	/*
 	 * Accumulate the aggregate statistics for the student's mm package
 	 */
@@ -364,19 +820,7 @@ int main(int argc, char **argv)
 	if (errors == 0)
 	{
 		avg_mm_throughput = ops / secs;
-
-		p1 = UTIL_WEIGHT * avg_mm_util;
-		if (avg_mm_throughput > AVG_LIBC_THRUPUT)
-		{
-			p2 = (double)(1.0 - UTIL_WEIGHT);
-		}
-		else
-		{
-			p2 = ((double)(1.0 - UTIL_WEIGHT)) *
-				 (avg_mm_throughput / AVG_LIBC_THRUPUT);
-		}
-
-		perfindex = (p1 + p2) * 100.0;
+		perfindex = perf_index(avg_mm_util, avg_mm_throughput, &p1, &p2);
 		printf("Perf index = %.0f (util) + %.0f (thru) = %.0f/100\n",
 			   p1 * 100,
 			   p2 * 100,
@@ -394,26 +838,40 @@ int main(int argc, char **argv)
 		printf("perfidx:%.0f\n", perfindex);
 	}
 
-	exit(0);
+	/*
+	 * Benchmark the traces, and fail if they got slower than the
+	 * baseline. An invalid trace skips the benchmark and exits with
+	 * status 1, so a broken allocator cannot pass as "no regressions".
+	 */
+	if (errors > 0)
+		exit(1);
+	if (bench_reps > 0)
+		regressions = bench_traces(tracefiles, num_tracefiles, bench_reps,
+								   bench_out, bench_base);
+
+	exit(regressions > 0 ? 2 : 0);
 }
 
 /*****************************************************************
- * The following routines manipulate the range list, which keeps
+ * The following routines manipulate the range tree, which keeps
  * track of the extent of every allocated block payload. We use the
- * range list to detect any overlapping allocated blocks.
+ * range tree to detect any overlapping allocated blocks. Lookups
+ * splay the tree, so checking a trace of n requests takes
+ * O(n log n) time instead of the O(n^2) a plain list would.
  ****************************************************************/
 
 /*
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of
  *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list.
+ *     we create a range struct for this block and add it to the range tree.
  */
 static int add_range(range_t **ranges, char *lo, int size,
 					 int tracenum, int opnum)
 {
 	char *hi = lo + size - 1;
 	range_t *p;
+	range_t *root;
 	char msg[MAXLINE];
 
 	assert(size > 0);
@@ -428,8 +886,7 @@ static int add_range(range_t **ranges, char *lo, int size,
 	}
 
 	/* The payload must lie within the extent of the heap */
-	if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
-		(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi()))
+	if (!mem_in_heap(lo, hi))
 	{
 		sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
 				lo, hi, mem_heap_lo(), mem_heap_hi());
@@ -437,28 +894,57 @@ static int add_range(range_t **ranges, char *lo, int size,
 		return 0;
 	}
 
-	/* The payload must not overlap any other payloads */
-	for (p = *ranges; p != NULL; p = p->next)
+	/*
+	 * The payload must not overlap any other payloads. Only the
+	 * nearest payloads on either side of lo can overlap it, and they
+	 * are the last nodes we turned left and right at on the way down.
+	 */
+	for (p = *ranges; p != NULL;)
 	{
-		if ((lo >= p->lo && lo <= p->hi) ||
-			(hi >= p->lo && hi <= p->hi))
+		if (lo < p->lo)
 		{
-			sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
-					lo, hi, p->lo, p->hi);
-			malloc_error(tracenum, opnum, msg);
-			return 0;
+			if (hi >= p->lo)
+				break;
+			p = p->left;
+		}
+		else
+		{
+			if (lo <= p->hi)
+				break;
+			p = p->right;
 		}
 	}
+	if (p != NULL)
+	{
+		sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
+				lo, hi, p->lo, p->hi);
+		malloc_error(tracenum, opnum, msg);
+		return 0;
+	}
 
 	/*
-	 * Everything looks OK, so remember the extent of this block
-	 * by creating a range struct and adding it the range list.
+	 * Everything looks OK, so remember the extent of this block by
+	 * splitting the tree around lo and making a new root for it.
 	 */
-	if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
-		unix_error("malloc error in add_range");
-	p->next = *ranges;
+	p = new_range();
 	p->lo = lo;
 	p->hi = hi;
+	p->left = p->right = NULL;
+	if ((root = splay_range(*ranges, lo)) != NULL)
+	{
+		if (lo < root->lo)
+		{
+			p->left = root->left;
+			p->right = root;
+			root->left = NULL;
+		}
+		else
+		{
+			p->right = root->right;
+			p->left = root;
+			root->right = NULL;
+		}
+	}
 	*ranges = p;
 	return 1;
 }
@@ -468,21 +954,23 @@ static int add_range(range_t **ranges, char *lo, int size,
  */
 static void remove_range(range_t **ranges, char *lo)
 {
-	range_t *p;
-	range_t **prevpp = ranges;
-	int size;
+	range_t *p = splay_range(*ranges, lo);
 
-	for (p = *ranges; p != NULL; p = p->next)
+	*ranges = p;
+	if (p == NULL || p->lo != lo)
+		return;
+
+	/* Every key on the left is below lo, so splaying it for lo leaves
+	   its largest record at the root with an empty right subtree */
+	if (p->left == NULL)
+		*ranges = p->right;
+	else
 	{
-		if (p->lo == lo)
-		{
-			*prevpp = p->next;
-			size = p->hi - p->lo + 1;
-			free(p);
-			break;
-		}
-		prevpp = &(p->next);
+		*ranges = splay_range(p->left, lo);
+		(*ranges)->right = p->right;
 	}
+	p->right = range_free;
+	range_free = p;
 }
 
 /*
@@ -490,23 +978,109 @@ static void remove_range(range_t **ranges, char *lo)
  */
 static void clear_ranges(range_t **ranges)
 {
-	range_t *p;
-	range_t *pnext;
+	range_chunk_t *c;
 
-	for (p = *ranges; p != NULL; p = pnext)
+	while ((c = range_chunks) != NULL)
 	{
-		pnext = p->next;
-		free(p);
+		range_chunks = c->next;
+		free(c);
 	}
+	range_chunk_used = RANGE_CHUNK;
+	range_free = NULL;
 	*ranges = NULL;
 }
 
+/*
+ * splay_range - Top-down splay of tree t for key lo. Returns the new
+ *     root, which is the record starting at lo if there is one and
+ *     otherwise its nearest neighbor on one side.
+ */
+static range_t *splay_range(range_t *t, char *lo)
+{
+	range_t N, *l, *r, *y;
+
+	if (t == NULL)
+		return NULL;
+	N.left = N.right = NULL;
+	l = r = &N;
+	for (;;)
+	{
+		if (lo < t->lo)
+		{
+			if (t->left == NULL)
+				break;
+			if (lo < t->left->lo)
+			{ /* rotate right */
+				y = t->left;
+				t->left = y->right;
+				y->right = t;
+				t = y;
+				if (t->left == NULL)
+					break;
+			}
+			r->left = t; /* link right */
+			r = t;
+			t = t->left;
+		}
+		else if (lo > t->lo)
+		{
+			if (t->right == NULL)
+				break;
+			if (lo > t->right->lo)
+			{ /* rotate left */
+				y = t->right;
+				t->right = y->left;
+				y->left = t;
+				t = y;
+				if (t->right == NULL)
+					break;
+			}
+			l->right = t; /* link left */
+			l = t;
+			t = t->right;
+		}
+		else
+			break;
+	}
+	l->right = t->left; /* assemble */
+	r->left = t->right;
+	t->left = N.right;
+	t->right = N.left;
+	return t;
+}
+
+/*
+ * new_range - Take a range record from the pool, adding a chunk of
+ *     RANGE_CHUNK records when the free list and the chunk run dry
+ */
+static range_t *new_range(void)
+{
+	range_chunk_t *c;
+	range_t *p;
+
+	if ((p = range_free) != NULL)
+	{
+		range_free = p->right;
+		return p;
+	}
+	if (range_chunk_used == RANGE_CHUNK)
+	{
+		if ((c = (range_chunk_t *)malloc(sizeof(range_chunk_t))) == NULL)
+			unix_error("malloc error in add_range");
+		c->next = range_chunks;
+		range_chunks = c;
+		range_chunk_used = 0;
+	}
+	return &range_chunks->nodes[range_chunk_used++];
+}
+
 /**********************************************
  * The following routines manipulate tracefiles
  *********************************************/
 
 /*
- * read_trace - read a trace file and store it in memory
+ * read_trace - read a trace file and store it in memory. Binary
+ *     traces are mapped in place by map_trace instead of parsed.
  */
 static trace_t *read_trace(char *tracedir, char *filename)
 {
@@ -528,6 +1102,10 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	/* Read the trace file header */
 	strcpy(path, tracedir);
 	strcat(path, filename);
+	trace->map = NULL;
+	trace->map_len = 0;
+	if (map_trace(trace, path))
+		return trace;
 	if ((tracefile = fopen(path, "r")) == NULL)
 	{
 		sprintf(msg, "Could not open %s in read_trace", path);
@@ -593,68 +1171,465 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	return trace;
 }
 
+/*
+ * map_trace - If path is a binary trace (see trace.h), map it read-only
+ *     and point trace->ops straight at the packed records. Pages are
+ *     faulted in lazily during the replay, so loading costs one open
+ *     and one mmap no matter how long the trace is, plus one pass
+ *     that checks every record. Returns 0 (and leaves trace untouched)
+ *     if path is a text .rep file.
+ */
+static int map_trace(trace_t *trace, char *path)
+{
+	int fd, i;
+	struct stat st;
+	tracehdr_t hdr;
+	char *map;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+	{
+		sprintf(msg, "Could not open %s in read_trace", path);
+		unix_error(msg);
+	}
+	if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+		memcmp(hdr.magic, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0)
+	{
+		close(fd);
+		return 0;
+	}
+
+	if (hdr.op_size != sizeof(traceop_t) || hdr.num_ops < 0 || hdr.num_ids < 0)
+	{
+		sprintf(msg, "Binary trace %s was written with a different layout", path);
+		app_error(msg);
+	}
+	if (fstat(fd, &st) < 0)
+		unix_error("fstat failed in read_trace");
+	if ((size_t)st.st_size < sizeof(hdr) + (size_t)hdr.num_ops * sizeof(traceop_t))
+	{
+		sprintf(msg, "Binary trace %s is truncated", path);
+		app_error(msg);
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		unix_error("mmap failed in read_trace");
+
+	trace->sugg_heapsize = hdr.sugg_heapsize;
+	trace->num_ids = hdr.num_ids;
+	trace->num_ops = hdr.num_ops;
+	trace->weight = hdr.weight;
+	trace->ops = (traceop_t *)(map + sizeof(hdr));
+	trace->map = map;
+	trace->map_len = st.st_size;
+
+	/* The replay indexes blocks[] with the records as they are */
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		traceop_t *op = &trace->ops[i];
+
+		if ((op->type != ALLOC && op->type != FREE && op->type != REALLOC) ||
+			op->index < 0 || op->index >= trace->num_ids || op->size < 0)
+		{
+			sprintf(msg, "Binary trace %s has a bad request %d (type %d, id %d, size %d)",
+					path, i, (int)op->type, op->index, op->size);
+			app_error(msg);
+		}
+	}
+
+	if ((trace->blocks =
+			 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
+		unix_error("malloc 3 failed in read_trace");
+	if ((trace->block_sizes =
+			 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
+		unix_error("malloc 4 failed in read_trace");
+	return 1;
+}
+
 /*
  * free_trace - Free the trace record and the three arrays it points
  *              to, all of which were allocated in read_trace().
  */
 void free_trace(trace_t *trace)
 {
-	free(trace->ops); /* free the three arrays... */
+	if (trace->map != NULL) /* binary traces borrow ops from the file */
+		munmap(trace->map, trace->map_len);
+	else
+		free(trace->ops); /* free the three arrays... */
 	free(trace->blocks);
 	free(trace->block_sizes);
 	free(trace); /* and the trace record itself... */
 }
 
-/**********************************************************************
- * The following functions evaluate the correctness, space utilization,
- * and throughput of the libc and mm malloc packages.
- **********************************************************************/
+/*******************************************************************
+ * The following routines stream a tracefile (-r). The replay takes
+ * requests from stream_next while a reader thread parses the next
+ * block, and an idmap_t stands in for the blocks arrays.
+ ******************************************************************/
 
 /*
- * eval_mm_valid - Check the mm malloc package for correctness
+ * stream_open - Read the header of the trace at path, text or binary,
+ *     and start a reader thread that fills the request buffers
  */
-static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
+static stream_t *stream_open(char *path)
 {
-	int i, j;
-	int index;
-	int size;
-	int oldsize;
-	char *newp;
-	char *oldp;
-	char *p;
+	stream_t *s;
+	tracehdr_t hdr;
+	int sugg_heapsize, num_ids, weight;
 
-	/* Reset the heap and free any records in the range list */
-	mem_reset_brk();
-	clear_ranges(ranges);
+	if ((s = (stream_t *)calloc(1, sizeof(stream_t))) == NULL ||
+		(s->buf[0] = (traceop_t *)malloc(2 * STREAM_OPS * sizeof(traceop_t))) == NULL)
+		unix_error("malloc failed in stream_open");
+	s->buf[1] = s->buf[0] + STREAM_OPS;
 
-	/* Call the mm package's init function */
-	if (mm_init() < 0)
+	if ((s->fp = fopen(path, "r")) == NULL)
 	{
-		malloc_error(tracenum, 0, "mm_init failed.");
-		return 0;
+		sprintf(msg, "Could not open %s in stream_open", path);
+		unix_error(msg);
 	}
+	posix_fadvise(fileno(s->fp), 0, 0, POSIX_FADV_SEQUENTIAL);
 
-	/* Interpret each operation in the trace in order */
-	for (i = 0; i < trace->num_ops; i++)
+	if (fread(&hdr, sizeof(hdr), 1, s->fp) == 1 &&
+		memcmp(hdr.magic, TRACE_MAGIC, TRACE_MAGIC_LEN) == 0)
 	{
-		index = trace->ops[i].index;
-		size = trace->ops[i].size;
-
-		switch (trace->ops[i].type)
+		if (hdr.op_size != sizeof(traceop_t) || hdr.num_ops < 0)
+		{
+			sprintf(msg, "Binary trace %s was written with a different layout", path);
+			app_error(msg);
+		}
+		s->binary = 1;
+		s->num_ops = hdr.num_ops;
+	}
+	else
+	{
+		rewind(s->fp);
+		if (fscanf(s->fp, "%d %d %ld %d", &sugg_heapsize, &num_ids,
+				   &s->num_ops, &weight) != 4 ||
+			s->num_ops < 0)
 		{
+			sprintf(msg, "Bad header in tracefile %s", path);
+			app_error(msg);
+		}
+	}
 
-		case ALLOC: /* mm_malloc */
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_cond_init(&s->cond, NULL);
+	if (pthread_create(&s->reader, NULL, stream_reader, s) != 0)
+		app_error("pthread_create failed in stream_open");
+	return s;
+}
 
-			/* Call the student's malloc */
-			if ((p = mm_malloc(size)) == NULL)
-			{
-				malloc_error(tracenum, i, "mm_malloc failed.");
-				return 0;
+/*
+ * stream_next - The next request of the trace, or NULL after the last.
+ *     Hands the finished buffer back to the reader and waits for the
+ *     other one when the current buffer runs out.
+ */
+static traceop_t *stream_next(stream_t *s)
+{
+	if (s->pos == s->len)
+	{
+		if (s->held && s->len == 0)
+			return NULL;
+		pthread_mutex_lock(&s->lock);
+		if (s->held)
+		{
+			s->filled[s->cur] = 0;
+			s->cur ^= 1;
+			pthread_cond_broadcast(&s->cond);
+		}
+		if (!s->filled[s->cur])
+		{
+			double t = mono_secs();
+
+			while (!s->filled[s->cur])
+				pthread_cond_wait(&s->cond, &s->lock);
+			s->waited += mono_secs() - t;
+		}
+		s->held = 1;
+		s->len = s->count[s->cur];
+		pthread_mutex_unlock(&s->lock);
+		s->pos = 0;
+		if (s->len == 0)
+		{
+			if (s->error[0] != '\0')
+				app_error(s->error);
+			return NULL;
+		}
+	}
+	return &s->buf[s->cur][s->pos++];
+}
+
+/*
+ * stream_close - Stop the reader thread and free the stream
+ */
+static void stream_close(stream_t *s)
+{
+	pthread_mutex_lock(&s->lock);
+	s->stop = 1;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+	pthread_join(s->reader, NULL);
+
+	pthread_mutex_destroy(&s->lock);
+	pthread_cond_destroy(&s->cond);
+	fclose(s->fp);
+	free(s->buf[0]);
+	free(s);
+}
+
+/*
+ * stream_reader - Body of the reader thread: fill the two buffers in
+ *     turn, waiting for the replay to hand each one back. An empty
+ *     buffer marks the end of the trace (or a read error).
+ */
+static void *stream_reader(void *ptr)
+{
+	stream_t *s = (stream_t *)ptr;
+	int b = 0, n;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&s->lock);
+		while (s->filled[b] && !s->stop)
+			pthread_cond_wait(&s->cond, &s->lock);
+		if (s->stop)
+		{
+			pthread_mutex_unlock(&s->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&s->lock);
+
+		n = stream_fill(s, s->buf[b]);
+
+		pthread_mutex_lock(&s->lock);
+		s->count[b] = n;
+		s->filled[b] = 1;
+		pthread_cond_broadcast(&s->cond);
+		pthread_mutex_unlock(&s->lock);
+		if (n == 0)
+			return NULL;
+		b ^= 1;
+	}
+}
+
+/*
+ * stream_fill - Read up to STREAM_OPS requests into buf. Returns how
+ *     many; 0 at the end of the trace, with s->error set if the file
+ *     ended early or holds a bad request.
+ */
+static int stream_fill(stream_t *s, traceop_t *buf)
+{
+	char type[MAXLINE];
+	unsigned index, size;
+	int n, want;
+
+	want = (s->num_ops - s->num_read < STREAM_OPS) ? (int)(s->num_ops - s->num_read)
+												   : STREAM_OPS;
+	if (s->binary)
+	{
+		n = fread(buf, sizeof(traceop_t), want, s->fp);
+		for (int i = 0; i < n; i++)
+			if ((buf[i].type != ALLOC && buf[i].type != FREE && buf[i].type != REALLOC) ||
+				buf[i].index < 0 || buf[i].size < 0)
+			{
+				sprintf(s->error, "Bad request (type %d, id %d, size %d) in streamed tracefile",
+						(int)buf[i].type, buf[i].index, buf[i].size);
+				return 0;
+			}
+	}
+	else
+		for (n = 0; n < want && fscanf(s->fp, "%s", type) == 1; n++)
+		{
+			size = 0;
+			if (type[0] == 'f')
+			{
+				if (fscanf(s->fp, "%u", &index) != 1)
+					break;
+				buf[n].type = FREE;
+			}
+			else if (type[0] == 'a' || type[0] == 'r')
+			{
+				if (fscanf(s->fp, "%u %u", &index, &size) != 2)
+					break;
+				buf[n].type = (type[0] == 'a') ? ALLOC : REALLOC;
+			}
+			else
+			{
+				sprintf(s->error, "Bogus type character (%c) in streamed tracefile",
+						type[0]);
+				return 0;
+			}
+			buf[n].index = index;
+			buf[n].size = size;
+		}
+
+	s->num_read += n;
+	if (n < want)
+	{
+		sprintf(s->error, "Streamed tracefile ends after %ld of %ld requests",
+				s->num_read, s->num_ops);
+		return 0;
+	}
+	return n;
+}
+
+/*
+ * idmap_init - Start an empty id map
+ */
+static void idmap_init(idmap_t *m)
+{
+	unsigned i;
+
+	if ((m->slots = (idslot_t *)malloc(IDMAP_MIN * sizeof(idslot_t))) == NULL)
+		unix_error("malloc failed in idmap_init");
+	for (i = 0; i < IDMAP_MIN; i++)
+		m->slots[i].id = -1;
+	m->mask = IDMAP_MIN - 1;
+	m->count = 0;
+}
+
+/* Home slot of id (Fibonacci hashing spreads consecutive ids) */
+#define IDMAP_HOME(m, id) (((unsigned)(id) * 2654435761u) & (m)->mask)
+
+/*
+ * idmap_insert - Slot for id, added if id is not live yet. Doubles
+ *     the table once it would be more than half full.
+ */
+static idslot_t *idmap_insert(idmap_t *m, int id)
+{
+	idslot_t *old = m->slots, *slot;
+	unsigned i, cap = m->mask + 1;
+
+	if (2 * (m->count + 1) > cap)
+	{
+		if ((m->slots = (idslot_t *)malloc(2 * cap * sizeof(idslot_t))) == NULL)
+			unix_error("malloc failed in idmap_insert");
+		m->mask = 2 * cap - 1;
+		for (i = 0; i < 2 * cap; i++)
+			m->slots[i].id = -1;
+		for (i = 0; i < cap; i++)
+			if (old[i].id >= 0)
+			{
+				unsigned j = IDMAP_HOME(m, old[i].id);
+				while (m->slots[j].id >= 0)
+					j = (j + 1) & m->mask;
+				m->slots[j] = old[i];
+			}
+		free(old);
+	}
+
+	for (i = IDMAP_HOME(m, id);; i = (i + 1) & m->mask)
+	{
+		slot = &m->slots[i];
+		if (slot->id == id)
+			return slot;
+		if (slot->id < 0)
+		{
+			slot->id = id;
+			m->count++;
+			return slot;
+		}
+	}
+}
+
+/*
+ * idmap_get - Slot of live id; a trace that reallocs or frees an id
+ *     that is not live is broken
+ */
+static idslot_t *idmap_get(idmap_t *m, int id)
+{
+	unsigned i;
+
+	for (i = IDMAP_HOME(m, id); m->slots[i].id >= 0; i = (i + 1) & m->mask)
+		if (m->slots[i].id == id)
+			return &m->slots[i];
+	sprintf(msg, "Streamed trace uses id %d, which is not allocated", id);
+	app_error(msg);
+	return NULL;
+}
+
+/*
+ * idmap_remove - Drop slot, shifting later entries of its probe run
+ *     back so lookups never need tombstones
+ */
+static void idmap_remove(idmap_t *m, idslot_t *slot)
+{
+	unsigned i = slot - m->slots, j, home;
+
+	for (j = (i + 1) & m->mask; m->slots[j].id >= 0; j = (j + 1) & m->mask)
+	{
+		/* the entry at j may fill the hole at i unless its home lies in (i, j] */
+		home = IDMAP_HOME(m, m->slots[j].id);
+		if (((j - home) & m->mask) >= ((j - i) & m->mask))
+		{
+			m->slots[i] = m->slots[j];
+			i = j;
+		}
+	}
+	m->slots[i].id = -1;
+	m->count--;
+}
+
+/**********************************************************************
+ * The following functions evaluate the correctness, space utilization,
+ * and throughput of the libc and mm malloc packages.
+ **********************************************************************/
+
+/*
+ * eval_mm_valid - Check the mm malloc package for correctness
+ */
+static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
+{
+	int i, j;
+	int index;
+	int size;
+	int oldsize;
+	char *newp;
+	char *oldp;
+	char *p;
+
+	/* Reset the heap and free any records in the range tree */
+	mem_reset_brk();
+	clear_ranges(ranges);
+
+	/* Call the mm package's init function */
+	if (mm_init() < 0)
+	{
+		malloc_error(tracenum, 0, "mm_init failed.");
+		return 0;
+	}
+
+	/* Interpret each operation in the trace in order */
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		index = trace->ops[i].index;
+		size = trace->ops[i].size;
+
+		/* With -m, hand a whole run of requests to one batch call */
+		if (batch_mode && (j = batch_run(trace, i)) > 1)
+		{
+			if (!eval_mm_batch(trace, tracenum, ranges, i, j))
+				return 0;
+			i += j - 1;
+			continue;
+		}
+
+		switch (trace->ops[i].type)
+		{
+
+		case ALLOC: /* mm_malloc */
+
+			/* Call the student's malloc */
+			if ((p = mm_malloc(size)) == NULL)
+			{
+				malloc_error(tracenum, i, "mm_malloc failed.");
+				return 0;
 			}
 
 			/*
 			 * Test the range of the new block for correctness and add it
-			 * to the range list if OK. The block must be  be aligned properly,
+			 * to the range tree if OK. The block must be  be aligned properly,
 			 * and must not overlap any currently allocated block.
 			 */
 			if (add_range(ranges, p, size, tracenum, i) == 0)
@@ -682,10 +1657,10 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 				return 0;
 			}
 
-			/* Remove the old region from the range list */
+			/* Remove the old region from the range tree */
 			remove_range(ranges, oldp);
 
-			/* Check new block for correctness and add it to range list */
+			/* Check new block for correctness and add it to range tree */
 			if (add_range(ranges, newp, size, tracenum, i) == 0)
 				return 0;
 
@@ -699,7 +1674,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 				oldsize = size;
 			for (j = 0; j < oldsize; j++)
 			{
-				if (newp[j] != (index & 0xFF))
+				if ((unsigned char)newp[j] != (index & 0xFF))
 				{
 					malloc_error(tracenum, i, "mm_realloc did not preserve the "
 											  "data from old block");
@@ -727,6 +1702,149 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	}
 
 	/* As far as we know, this is a valid malloc package */
+	return eval_mm_sized(trace, tracenum, ranges) &&
+		   eval_mm_huge(tracenum, trace->num_ops);
+}
+
+/*
+ * eval_mm_sized - Replay the trace again on a fresh heap, freeing
+ *     every block with mm_free_sized and trying mm_try_expand before
+ *     each realloc. A block that grew in place must keep its address
+ *     and its data; CHECK=1 builds also run mm_check after every
+ *     successful expand and once the trace is done.
+ */
+static int eval_mm_sized(trace_t *trace, int tracenum, range_t **ranges)
+{
+	int i, j;
+	int index;
+	int size;
+	int oldsize;
+	int expanded;
+	char *newp;
+	char *oldp;
+	char *p;
+
+	mem_reset_brk();
+	clear_ranges(ranges);
+	if (mm_init() < 0)
+	{
+		malloc_error(tracenum, 0, "mm_init failed.");
+		return 0;
+	}
+
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		index = trace->ops[i].index;
+		size = trace->ops[i].size;
+
+		switch (trace->ops[i].type)
+		{
+
+		case ALLOC:
+			if ((p = mm_malloc(size)) == NULL)
+			{
+				malloc_error(tracenum, i, "mm_malloc failed.");
+				return 0;
+			}
+			if (add_range(ranges, p, size, tracenum, i) == 0)
+				return 0;
+			memset(p, index & 0xFF, size);
+			trace->blocks[index] = p;
+			trace->block_sizes[index] = size;
+			break;
+
+		case REALLOC:
+			oldp = trace->blocks[index];
+			newp = oldp;
+			if (!(expanded = mm_try_expand(oldp, size)))
+			{
+				if ((newp = mm_realloc(oldp, size)) == NULL)
+				{
+					malloc_error(tracenum, i, "mm_realloc failed.");
+					return 0;
+				}
+			}
+#ifdef MM_CHECK
+			else if (mm_check() != 0)
+			{
+				malloc_error(tracenum, i, "mm_check failed after mm_try_expand.");
+				return 0;
+			}
+#endif
+			remove_range(ranges, oldp);
+			if (add_range(ranges, newp, size, tracenum, i) == 0)
+				return 0;
+
+			oldsize = trace->block_sizes[index];
+			if (size < oldsize)
+				oldsize = size;
+			for (j = 0; j < oldsize; j++)
+			{
+				if ((unsigned char)newp[j] != (index & 0xFF))
+				{
+					malloc_error(tracenum, i, expanded ?
+							"mm_try_expand did not preserve the data in the block" :
+							"mm_realloc did not preserve the data from old block");
+					return 0;
+				}
+			}
+			memset(newp, index & 0xFF, size);
+			trace->blocks[index] = newp;
+			trace->block_sizes[index] = size;
+			break;
+
+		case FREE:
+			p = trace->blocks[index];
+			remove_range(ranges, p);
+			mm_free_sized(p, trace->block_sizes[index]);
+			break;
+
+		default:
+			app_error("Nonexistent request type in eval_mm_sized");
+		}
+	}
+
+#ifdef MM_CHECK
+	if (mm_check() != 0)
+	{
+		malloc_error(tracenum, trace->num_ops, "mm_check failed after the mm_free_sized replay.");
+		return 0;
+	}
+#endif
+	return 1;
+}
+
+/*
+ * eval_mm_huge - Check that requests too large for any heap fail
+ *     with NULL instead of wrapping around to a small block, and that
+ *     a failed realloc leaves the old block alone
+ */
+static int eval_mm_huge(int tracenum, int opnum)
+{
+	char *p;
+
+	if (mm_malloc(SIZE_MAX) != NULL || mm_malloc(SIZE_MAX - 8) != NULL)
+	{
+		malloc_error(tracenum, opnum, "mm_malloc(SIZE_MAX) did not fail.");
+		return 0;
+	}
+	if (mm_memalign(64, SIZE_MAX) != NULL)
+	{
+		malloc_error(tracenum, opnum, "mm_memalign(64, SIZE_MAX) did not fail.");
+		return 0;
+	}
+	if ((p = mm_malloc(16)) == NULL)
+	{
+		malloc_error(tracenum, opnum, "mm_malloc failed.");
+		return 0;
+	}
+	memset(p, 0x5a, 16);
+	if (mm_realloc(p, SIZE_MAX - 8) != NULL || p[0] != 0x5a || p[15] != 0x5a)
+	{
+		malloc_error(tracenum, opnum, "mm_realloc(p, SIZE_MAX - 8) did not fail cleanly.");
+		return 0;
+	}
+	mm_free(p);
 	return 1;
 }
 
@@ -735,10 +1853,9 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  *   The idea is to remember the high water mark "hwm" of the heap for
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
  *   Utilization is the ratio hwm/heapsize, where heapsize is the
- *   size of the heap in bytes after running the student's malloc
- *   package on the trace. Note that our implementation of mem_sbrk()
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap.
+ *   peak size of the heap in bytes while running the student's malloc
+ *   package on the trace. mem_sbrk() lets the package decrement the
+ *   brk pointer, so the final heap size would overstate utilization.
  *
  */
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
@@ -819,7 +1936,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 		}
 	}
 
-	return ((double)max_total_size / (double)mem_heapsize());
+	return ((double)max_total_size / (double)mem_peak_heapsize());
 }
 
 /*
@@ -871,22 +1988,786 @@ static void eval_mm_speed(void *ptr)
 }
 
 /*
- * eval_libc_valid - We run this function to make sure that the
- *    libc malloc can run to completion on the set of traces.
- *    We'll be conservative and terminate if any libc malloc call fails.
- *
+ * batch_run - Length of the run starting at request i that one batch
+ *     call can serve: consecutive mallocs of the same size, or
+ *     consecutive frees, at most BATCH_MAX of either
  */
-static int eval_libc_valid(trace_t *trace, int tracenum)
+static int batch_run(trace_t *trace, int i)
 {
-	int i, newsize;
-	char *p, *newp, *oldp;
+	traceop_t *op = &trace->ops[i];
+	int n = 1;
+
+	if (op->type == REALLOC)
+		return 1;
+	while (n < BATCH_MAX && i + n < trace->num_ops && op[n].type == op->type &&
+		   (op->type == FREE || op[n].size == op->size))
+		n++;
+	return n;
+}
 
-	for (i = 0; i < trace->num_ops; i++)
+/*
+ * eval_mm_batch - Serve the n requests from i with one mm_malloc_batch
+ *     or mm_free_batch call, with eval_mm_valid's checks: every new
+ *     block must be aligned and overlap no other, and every block must
+ *     still hold its data when it is freed
+ */
+static int eval_mm_batch(trace_t *trace, int tracenum, range_t **ranges, int i, int n)
+{
+	traceop_t *op = &trace->ops[i];
+	void *ptrs[BATCH_MAX];
+	char *p;
+	int j, k;
+
+	if (op->type == ALLOC)
 	{
-		switch (trace->ops[i].type)
+		if ((int)mm_malloc_batch(op->size, n, ptrs) != n)
 		{
-
-		case ALLOC: /* malloc */
+			malloc_error(tracenum, i, "mm_malloc_batch failed.");
+			return 0;
+		}
+		for (j = 0; j < n; j++)
+		{
+			if (add_range(ranges, ptrs[j], op->size, tracenum, i + j) == 0)
+				return 0;
+			memset(ptrs[j], op[j].index & 0xFF, op->size);
+			trace->blocks[op[j].index] = ptrs[j];
+			trace->block_sizes[op[j].index] = op->size;
+		}
+		return 1;
+	}
+
+	for (j = 0; j < n; j++)
+	{
+		p = trace->blocks[op[j].index];
+		for (k = 0; k < (int)trace->block_sizes[op[j].index]; k++)
+		{
+			if ((unsigned char)p[k] != (op[j].index & 0xFF))
+			{
+				malloc_error(tracenum, i + j, "block lost its data before mm_free_batch");
+				return 0;
+			}
+		}
+		remove_range(ranges, p);
+		ptrs[j] = p;
+	}
+	mm_free_batch(ptrs, n);
+	return 1;
+}
+
+/*
+ * eval_mm_batch_speed - eval_mm_speed with the runs of batch_run
+ *     served by one batch call each (-m)
+ */
+static void eval_mm_batch_speed(void *ptr)
+{
+	int i, j, n, index;
+	char *p;
+	void *ptrs[BATCH_MAX];
+	traceop_t *op;
+	trace_t *trace = ((speed_t *)ptr)->trace;
+
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_mm_batch_speed");
+
+	for (i = 0; i < trace->num_ops; i += n)
+	{
+		op = &trace->ops[i];
+		n = batch_run(trace, i);
+		index = op->index;
+		switch (op->type)
+		{
+
+		case ALLOC: /* mm_malloc or mm_malloc_batch */
+			if (n == 1)
+			{
+				if ((p = mm_malloc(op->size)) == NULL)
+					app_error("mm_malloc error in eval_mm_batch_speed");
+				trace->blocks[index] = p;
+				break;
+			}
+			if ((int)mm_malloc_batch(op->size, n, ptrs) != n)
+				app_error("mm_malloc_batch error in eval_mm_batch_speed");
+			for (j = 0; j < n; j++)
+				trace->blocks[op[j].index] = ptrs[j];
+			break;
+
+		case REALLOC: /* mm_realloc */
+			if ((p = mm_realloc(trace->blocks[index], op->size)) == NULL)
+				app_error("mm_realloc error in eval_mm_batch_speed");
+			trace->blocks[index] = p;
+			break;
+
+		case FREE: /* mm_free or mm_free_batch */
+			if (n == 1)
+			{
+				mm_free(trace->blocks[index]);
+				break;
+			}
+			for (j = 0; j < n; j++)
+				ptrs[j] = trace->blocks[op[j].index];
+			mm_free_batch(ptrs, n);
+			break;
+
+		default:
+			app_error("Nonexistent request type in eval_mm_batch_speed");
+		}
+	}
+}
+
+/*
+ * eval_mm_stream_valid - eval_mm_valid for a streamed trace (-r):
+ *     the same checks, with live blocks kept in an id map
+ */
+static int eval_mm_stream_valid(char *path, int tracenum, range_t **ranges)
+{
+	stream_t *s;
+	idmap_t map;
+	idslot_t *b;
+	traceop_t *op;
+	int i, j, oldsize, valid = 1;
+	char *p;
+
+	/* Reset the heap and free any records in the range tree */
+	mem_reset_brk();
+	clear_ranges(ranges);
+
+	/* Call the mm package's init function */
+	if (mm_init() < 0)
+	{
+		malloc_error(tracenum, 0, "mm_init failed.");
+		return 0;
+	}
+
+	s = stream_open(path);
+	idmap_init(&map);
+	for (i = 0; valid && (op = stream_next(s)) != NULL; i++)
+	{
+		switch (op->type)
+		{
+
+		case ALLOC: /* mm_malloc */
+			if ((p = mm_malloc(op->size)) == NULL)
+			{
+				malloc_error(tracenum, i, "mm_malloc failed.");
+				valid = 0;
+				break;
+			}
+			if (add_range(ranges, p, op->size, tracenum, i) == 0)
+			{
+				valid = 0;
+				break;
+			}
+			memset(p, op->index & 0xFF, op->size);
+			b = idmap_insert(&map, op->index);
+			b->p = p;
+			b->size = op->size;
+			break;
+
+		case REALLOC: /* mm_realloc */
+			b = idmap_get(&map, op->index);
+			if ((p = mm_realloc(b->p, op->size)) == NULL)
+			{
+				malloc_error(tracenum, i, "mm_realloc failed.");
+				valid = 0;
+				break;
+			}
+			remove_range(ranges, b->p);
+			if (add_range(ranges, p, op->size, tracenum, i) == 0)
+			{
+				valid = 0;
+				break;
+			}
+			oldsize = (op->size < b->size) ? op->size : b->size;
+			for (j = 0; j < oldsize; j++)
+				if ((unsigned char)p[j] != (op->index & 0xFF))
+				{
+					malloc_error(tracenum, i, "mm_realloc did not preserve the "
+											  "data from old block");
+					valid = 0;
+					break;
+				}
+			memset(p, op->index & 0xFF, op->size);
+			b->p = p;
+			b->size = op->size;
+			break;
+
+		case FREE: /* mm_free */
+			b = idmap_get(&map, op->index);
+			remove_range(ranges, b->p);
+			mm_free(b->p);
+			idmap_remove(&map, b);
+			break;
+
+		default:
+			app_error("Nonexistent request type in eval_mm_stream_valid");
+		}
+	}
+
+	stream_close(s);
+	free(map.slots);
+	return valid && eval_mm_huge(tracenum, i);
+}
+
+/*
+ * eval_mm_stream_util - eval_mm_util for a streamed trace (-r)
+ */
+static double eval_mm_stream_util(char *path)
+{
+	stream_t *s;
+	idmap_t map;
+	idslot_t *b;
+	traceop_t *op;
+	long total_size = 0, max_total_size = 0;
+	char *p;
+
+	/* initialize the heap and the mm malloc package */
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_mm_stream_util");
+
+	s = stream_open(path);
+	idmap_init(&map);
+	while ((op = stream_next(s)) != NULL)
+	{
+		switch (op->type)
+		{
+
+		case ALLOC: /* mm_alloc */
+			if ((p = mm_malloc(op->size)) == NULL)
+				app_error("mm_malloc failed in eval_mm_stream_util");
+			b = idmap_insert(&map, op->index);
+			b->p = p;
+			b->size = op->size;
+			total_size += op->size;
+			break;
+
+		case REALLOC: /* mm_realloc */
+			b = idmap_get(&map, op->index);
+			if ((p = mm_realloc(b->p, op->size)) == NULL)
+				app_error("mm_realloc failed in eval_mm_stream_util");
+			total_size += op->size - b->size;
+			b->p = p;
+			b->size = op->size;
+			break;
+
+		case FREE: /* mm_free */
+			b = idmap_get(&map, op->index);
+			mm_free(b->p);
+			total_size -= b->size;
+			idmap_remove(&map, b);
+			break;
+
+		default:
+			app_error("Nonexistent request type in eval_mm_stream_util");
+		}
+		max_total_size = (total_size > max_total_size) ? total_size : max_total_size;
+	}
+
+	stream_close(s);
+	free(map.slots);
+	return ((double)max_total_size / (double)mem_peak_heapsize());
+}
+
+/*
+ * eval_mm_stream_speed - eval_mm_speed for a streamed trace (-r). The
+ *     reader thread parses the next block while this one is replayed,
+ *     but it only stays ahead for binary traces: fscanf on a .rep is
+ *     slower than most allocators. So the time spent opening and
+ *     closing the stream and blocked in stream_next is added up in
+ *     io_secs, for the caller to subtract from the fsecs result.
+ */
+static void eval_mm_stream_speed(void *ptr)
+{
+	speed_t *params = (speed_t *)ptr;
+	stream_t *s;
+	idmap_t map;
+	idslot_t *b;
+	traceop_t *op;
+	char *p;
+	double t;
+
+	/* Reset the heap and initialize the mm package */
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_mm_stream_speed");
+
+	t = mono_secs();
+	s = stream_open(params->path);
+	params->io_secs += mono_secs() - t;
+	idmap_init(&map);
+	while ((op = stream_next(s)) != NULL)
+		switch (op->type)
+		{
+
+		case ALLOC: /* mm_malloc */
+			if ((p = mm_malloc(op->size)) == NULL)
+				app_error("mm_malloc error in eval_mm_stream_speed");
+			idmap_insert(&map, op->index)->p = p;
+			break;
+
+		case REALLOC: /* mm_realloc */
+			b = idmap_get(&map, op->index);
+			if ((b->p = mm_realloc(b->p, op->size)) == NULL)
+				app_error("mm_realloc error in eval_mm_stream_speed");
+			break;
+
+		case FREE: /* mm_free */
+			b = idmap_get(&map, op->index);
+			mm_free(b->p);
+			idmap_remove(&map, b);
+			break;
+
+		default:
+			app_error("Nonexistent request type in eval_mm_stream_speed");
+		}
+
+	t = mono_secs();
+	params->io_secs += s->waited;
+	stream_close(s);
+	params->io_secs += mono_secs() - t;
+	params->io_calls++;
+	free(map.slots);
+}
+
+/*
+ * mono_secs - Seconds on the monotonic clock
+ */
+static double mono_secs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * read_cycles - Current value of the cycle counter as one 64-bit number
+ */
+static inline unsigned long long read_cycles(void)
+{
+	unsigned hi, lo;
+
+	access_counter(&hi, &lo);
+	return ((unsigned long long)hi << 32) | lo;
+}
+
+/*
+ * lat_bucket - Index of the latency histogram bucket holding v cycles
+ */
+static int lat_bucket(unsigned long long v)
+{
+	int shift;
+
+	if (v < 2 * LAT_SUB)
+		return (int)v;
+	shift = 63 - __builtin_clzll(v) - LAT_SUB_BITS;
+	return (shift + 1) * LAT_SUB + (int)((v >> shift) - LAT_SUB);
+}
+
+/*
+ * lat_size - Size class of a request of size bytes for the latency table
+ */
+static int lat_size(int size)
+{
+	if (size <= 64)
+		return 0;
+	if (size <= 512)
+		return 1;
+	if (size <= 4096)
+		return 2;
+	if (size <= 32768)
+		return 3;
+	return 4;
+}
+
+/*
+ * eval_mm_latency - Replay the trace once more with every mm_malloc,
+ *     mm_free, and mm_realloc call bracketed by cycle counter reads.
+ *     The counter's own overhead is measured first and subtracted.
+ *     Returns the filled-in histograms, which the caller keeps.
+ */
+static latency_t *eval_mm_latency(trace_t *trace)
+{
+	int i, op, index, size, cls;
+	char *p;
+	latency_t *lat;
+	unsigned long long start, cyc, ovhd = ~0ULL;
+
+	if ((lat = (latency_t *)calloc(1, sizeof(latency_t))) == NULL)
+		unix_error("calloc failed in eval_mm_latency");
+
+	for (i = 0; i < 1000; i++)
+	{
+		start = read_cycles();
+		cyc = read_cycles() - start;
+		ovhd = (cyc < ovhd) ? cyc : ovhd;
+	}
+
+	/* Reset the heap and initialize the mm package */
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_mm_latency");
+
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		op = trace->ops[i].type;
+		index = trace->ops[i].index;
+		size = trace->ops[i].size;
+		switch (op)
+		{
+		case ALLOC: /* mm_malloc */
+			start = read_cycles();
+			p = mm_malloc(size);
+			cyc = read_cycles() - start;
+			if (p == NULL)
+				app_error("mm_malloc error in eval_mm_latency");
+			trace->blocks[index] = p;
+			trace->block_sizes[index] = size;
+			break;
+
+		case REALLOC: /* mm_realloc */
+			start = read_cycles();
+			p = mm_realloc(trace->blocks[index], size);
+			cyc = read_cycles() - start;
+			if (p == NULL)
+				app_error("mm_realloc error in eval_mm_latency");
+			trace->blocks[index] = p;
+			trace->block_sizes[index] = size;
+			break;
+
+		case FREE: /* mm_free, classed by the size of the freed block */
+			size = trace->block_sizes[index];
+			start = read_cycles();
+			mm_free(trace->blocks[index]);
+			cyc = read_cycles() - start;
+			break;
+
+		default:
+			app_error("Nonexistent request type in eval_mm_latency");
+		}
+
+		cyc = (cyc > ovhd) ? cyc - ovhd : 0;
+		cls = lat_size(size);
+		lat->count[op][cls]++;
+		lat->hist[op][cls][lat_bucket(cyc)]++;
+		if (cyc > lat->max[op][cls])
+			lat->max[op][cls] = cyc;
+	}
+	return lat;
+}
+
+/*
+ * eval_mm_tlb - Replay the trace (loaded or streamed) once more with
+ *     the dTLB read counters running, and note how much of the heap
+ *     ended up on transparent hugepages
+ */
+static void eval_mm_tlb(speed_t *speed_params, tlb_t *tlb)
+{
+	int miss_fd, load_fd;
+	struct timespec t0, t1;
+
+	miss_fd = tlb_counter(PERF_COUNT_HW_CACHE_RESULT_MISS);
+	load_fd = tlb_counter(PERF_COUNT_HW_CACHE_RESULT_ACCESS);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	if (miss_fd >= 0)
+		ioctl(miss_fd, PERF_EVENT_IOC_ENABLE, 0);
+	if (load_fd >= 0)
+		ioctl(load_fd, PERF_EVENT_IOC_ENABLE, 0);
+	if (stream_traces)
+		eval_mm_stream_speed(speed_params);
+	else
+		eval_mm_speed(speed_params);
+	if (miss_fd >= 0)
+		ioctl(miss_fd, PERF_EVENT_IOC_DISABLE, 0);
+	if (load_fd >= 0)
+		ioctl(load_fd, PERF_EVENT_IOC_DISABLE, 0);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	tlb->misses = tlb_read(miss_fd);
+	tlb->loads = tlb_read(load_fd);
+	tlb->secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	tlb->huge_bytes = huge_resident();
+}
+
+/*
+ * tlb_counter - Open a disabled user-mode counter of dTLB reads with
+ *     the given result (access or miss) for this thread; -1 if the
+ *     kernel or CPU can't count them
+ */
+static int tlb_counter(unsigned long long result)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_DTLB |
+				  (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * tlb_read - Value of the counter fd and close it; -1 if fd is not open
+ */
+static long long tlb_read(int fd)
+{
+	unsigned long long v;
+
+	if (fd < 0)
+		return -1;
+	if (read(fd, &v, sizeof(v)) != sizeof(v))
+		v = -1;
+	close(fd);
+	return (long long)v;
+}
+
+/*
+ * huge_resident - Bytes of this process on transparent or hugetlbfs
+ *     pages, from /proc/self/smaps_rollup (0 if the kernel lacks it)
+ */
+static size_t huge_resident(void)
+{
+	FILE *fp;
+	char line[MAXLINE];
+	size_t kb, total = 0;
+
+	if ((fp = fopen("/proc/self/smaps_rollup", "r")) == NULL)
+		return 0;
+	while (fgets(line, MAXLINE, fp) != NULL)
+		if (sscanf(line, "AnonHugePages: %zu kB", &kb) == 1 ||
+			sscanf(line, "Private_Hugetlb: %zu kB", &kb) == 1 ||
+			sscanf(line, "Shared_Hugetlb: %zu kB", &kb) == 1)
+			total += kb;
+	fclose(fp);
+	return total * 1024;
+}
+
+#ifdef THREAD_CACHE
+/*
+ * eval_mm_mt_speed - This is the function that is used by fsecs()
+ *    to measure the running time of a multithreaded replay: every
+ *    thread replays the same trace against one shared mm heap.
+ */
+static void eval_mm_mt_speed(void *ptr)
+{
+	mt_speed_t *params = (mt_speed_t *)ptr;
+	pthread_t tids[params->num_threads];
+	mt_replay_t args[params->num_threads];
+	int t;
+
+	/* Reset the heap and initialize the mm package */
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_mm_mt_speed");
+
+	for (t = 0; t < params->num_threads; t++)
+	{
+		args[t].trace = params->trace;
+		args[t].blocks = params->blocks[t];
+		args[t].out = args[t].in = NULL;
+		if (params->rings != NULL)
+		{
+			params->rings[t].head = params->rings[t].tail = 0;
+			params->rings[t].done = 0;
+			args[t].out = &params->rings[t];
+			args[t].in = &params->rings[(t + 1) % params->num_threads];
+		}
+	}
+	for (t = 0; t < params->num_threads; t++)
+	{
+		if (pthread_create(&tids[t], NULL, mt_replay, &args[t]) != 0)
+			unix_error("pthread_create failed in eval_mm_mt_speed");
+	}
+	for (t = 0; t < params->num_threads; t++)
+		pthread_join(tids[t], NULL);
+}
+
+/*
+ * mt_replay - Body of one replay thread. Same as eval_mm_speed, but
+ *     the block pointers live in a per-thread array. In the hand-off
+ *     replay frees go to the ring instead, and the thread frees the
+ *     blocks of its neighbour's ring between requests and, once its
+ *     own trace is done, until the neighbour is done too.
+ */
+static void *mt_replay(void *ptr)
+{
+	mt_replay_t *arg = (mt_replay_t *)ptr;
+	trace_t *trace = arg->trace;
+	char **blocks = arg->blocks;
+	int i, index;
+	char *p;
+
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		index = trace->ops[i].index;
+		switch (trace->ops[i].type)
+		{
+		case ALLOC: /* mm_malloc */
+			if ((p = mm_malloc(trace->ops[i].size)) == NULL)
+				app_error("mm_malloc error in mt_replay");
+			blocks[index] = p;
+			break;
+
+		case REALLOC: /* mm_realloc */
+			if ((p = mm_realloc(blocks[index], trace->ops[i].size)) == NULL)
+				app_error("mm_realloc error in mt_replay");
+			blocks[index] = p;
+			break;
+
+		case FREE: /* mm_free */
+			if (arg->out != NULL)
+				handoff_put(arg, blocks[index]);
+			else
+				mm_free(blocks[index]);
+			break;
+
+		default:
+			app_error("Nonexistent request type in mt_replay");
+		}
+		if (arg->in != NULL)
+			handoff_drain(arg->in);
+	}
+
+	if (arg->out != NULL)
+	{
+		__atomic_store_n(&arg->out->done, 1, __ATOMIC_RELEASE);
+		while (!__atomic_load_n(&arg->in->done, __ATOMIC_ACQUIRE) ||
+			   handoff_drain(arg->in) > 0)
+			if (handoff_drain(arg->in) == 0)
+				sched_yield(); /* let the neighbour run on a busy machine */
+	}
+	return NULL;
+}
+
+/*
+ * handoff_put - Queue p for the previous thread to free. While the
+ *     ring is full, free from our own inbound ring, so that a cycle
+ *     of full rings still makes progress.
+ */
+static void handoff_put(mt_replay_t *arg, char *p)
+{
+	handoff_t *ring = arg->out;
+	unsigned long tail = ring->tail;
+
+	while (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == HANDOFF_SLOTS)
+		if (handoff_drain(arg->in) == 0)
+			sched_yield();
+	ring->slots[tail % HANDOFF_SLOTS] = p;
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * handoff_drain - mm_free every block queued in ring, return how many
+ */
+static int handoff_drain(handoff_t *ring)
+{
+	unsigned long head = ring->head;
+	unsigned long tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	int n = (int)(tail - head);
+
+	for (; head != tail; head++)
+		mm_free(ring->slots[head % HANDOFF_SLOTS]);
+	__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+	return n;
+}
+
+/*
+ * eval_mm_threads - For n = 1, 2, 4, ... max_threads, replay each
+ *     trace on n threads at once and print the aggregate throughput
+ *     over all of the traces, once with every thread freeing its own
+ *     blocks and once with each thread freeing its neighbour's
+ */
+static void eval_mm_threads(char **tracefiles, int num_tracefiles, int max_threads)
+{
+	mt_speed_t params;
+	trace_t **traces;
+	double secs, xsecs, ops, trace_ops = 0, base_kops = 0;
+	size_t max_heap = 0;
+	int i, n, t, max_ids = 0;
+
+	if ((traces = (trace_t **)malloc(num_tracefiles * sizeof(trace_t *))) == NULL)
+		unix_error("malloc 1 failed in eval_mm_threads");
+	for (i = 0; i < num_tracefiles; i++)
+	{
+		traces[i] = read_trace(tracedir, tracefiles[i]);
+		trace_ops += traces[i]->num_ops;
+		if (traces[i]->num_ids > max_ids)
+			max_ids = traces[i]->num_ids;
+	}
+
+	if ((params.blocks = (char ***)malloc(max_threads * sizeof(char **))) == NULL)
+		unix_error("malloc 2 failed in eval_mm_threads");
+	for (t = 0; t < max_threads; t++)
+		if ((params.blocks[t] = (char **)malloc(max_ids * sizeof(char *))) == NULL)
+			unix_error("malloc 3 failed in eval_mm_threads");
+	if ((params.rings = (handoff_t *)malloc(max_threads * sizeof(handoff_t))) == NULL)
+		unix_error("malloc 4 failed in eval_mm_threads");
+
+	printf("\nMultithreaded replay for mm malloc (hand-off: thread t frees thread t+1's blocks):\n");
+	printf("%7s%10s%10s%8s%9s%14s\n", "threads", "ops", "secs", "Kops", "speedup", "hand-off Kops");
+	for (n = 1; n <= max_threads; n = (n * 2 > max_threads && n < max_threads) ? max_threads : n * 2)
+	{
+		/* n copies of the largest heap seen on one thread must fit in memlib */
+		if (n * max_heap > mem_heap_limit())
+		{
+			printf("(stopping: %d copies of a %zu byte heap exceed the memlib limit)\n", n, max_heap);
+			break;
+		}
+		params.num_threads = n;
+		secs = xsecs = 0;
+		for (i = 0; i < num_tracefiles; i++)
+		{
+			handoff_t *rings = params.rings;
+
+			params.trace = traces[i];
+			params.rings = NULL;
+			secs += fsecs(eval_mm_mt_speed, &params);
+			if (n == 1 && mem_peak_heapsize() > max_heap)
+				max_heap = mem_peak_heapsize();
+			params.rings = rings;
+			xsecs += fsecs(eval_mm_mt_speed, &params);
+		}
+		ops = n * trace_ops;
+		if (n == 1)
+			base_kops = (ops / 1e3) / secs;
+		printf("%7d%10.0f%10.6f%8.0f%8.2fx%14.0f\n",
+			   n, ops, secs, (ops / 1e3) / secs, ((ops / 1e3) / secs) / base_kops,
+			   (ops / 1e3) / xsecs);
+	}
+	printf("\n");
+
+	free(params.rings);
+	for (t = 0; t < max_threads; t++)
+		free(params.blocks[t]);
+	free(params.blocks);
+	for (i = 0; i < num_tracefiles; i++)
+		free_trace(traces[i]);
+	free(traces);
+}
+#endif
+
+/*
+ * eval_libc_valid - We run this function to make sure that the
+ *    libc malloc can run to completion on the set of traces.
+ *    We'll be conservative and terminate if any libc malloc call fails.
+ *
+ */
+static int eval_libc_valid(trace_t *trace, int tracenum)
+{
+	int i, newsize;
+	char *p, *newp, *oldp;
+
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		switch (trace->ops[i].type)
+		{
+
+		case ALLOC: /* malloc */
 			if ((p = malloc(trace->ops[i].size)) == NULL)
 			{
 				malloc_error(tracenum, i, "libc malloc failed");
@@ -895,70 +2776,698 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 			trace->blocks[trace->ops[i].index] = p;
 			break;
 
-		case REALLOC: /* realloc */
-			newsize = trace->ops[i].size;
-			oldp = trace->blocks[trace->ops[i].index];
-			if ((newp = realloc(oldp, newsize)) == NULL)
-			{
-				malloc_error(tracenum, i, "libc realloc failed");
-				unix_error("System message");
-			}
-			trace->blocks[trace->ops[i].index] = newp;
-			break;
+		case REALLOC: /* realloc */
+			newsize = trace->ops[i].size;
+			oldp = trace->blocks[trace->ops[i].index];
+			if ((newp = realloc(oldp, newsize)) == NULL)
+			{
+				malloc_error(tracenum, i, "libc realloc failed");
+				unix_error("System message");
+			}
+			trace->blocks[trace->ops[i].index] = newp;
+			break;
+
+		case FREE: /* free */
+			free(trace->blocks[trace->ops[i].index]);
+			break;
+
+		default:
+			app_error("invalid operation type  in eval_libc_valid");
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * eval_libc_speed - This is the function that is used by fcyc() to
+ *    measure the running time of the libc malloc package on the set
+ *    of traces.
+ */
+static void eval_libc_speed(void *ptr)
+{
+	int i;
+	int index, size, newsize;
+	char *p, *newp, *oldp, *block;
+	trace_t *trace = ((speed_t *)ptr)->trace;
+
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		switch (trace->ops[i].type)
+		{
+		case ALLOC: /* malloc */
+			index = trace->ops[i].index;
+			size = trace->ops[i].size;
+			if ((p = malloc(size)) == NULL)
+				unix_error("malloc failed in eval_libc_speed");
+			trace->blocks[index] = p;
+			break;
+
+		case REALLOC: /* realloc */
+			index = trace->ops[i].index;
+			newsize = trace->ops[i].size;
+			oldp = trace->blocks[index];
+			if ((newp = realloc(oldp, newsize)) == NULL)
+				unix_error("realloc failed in eval_libc_speed\n");
+
+			trace->blocks[index] = newp;
+			break;
+
+		case FREE: /* free */
+			index = trace->ops[i].index;
+			block = trace->blocks[index];
+			free(block);
+			break;
+		}
+	}
+}
+
+/**************************************************
+ * Routines for running the traces through mm.c
+ **************************************************/
+
+/*
+ * eval_mm_trace - Check, measure and time mm.c on one trace and fill
+ *     in st; also dumps mm_stats() and heap snapshots if the -j and -s
+ *     files are given
+ */
+static void eval_mm_trace(char *tracename, int tracenum, range_t **ranges,
+						  stats_t *st, int latency, FILE *stats_fp,
+						  FILE *layout_fp, int layout_every)
+{
+	trace_t *trace;
+	speed_t speed_params;
+	char path[MAXLINE];
+	stream_t *s;
+
+	if (stream_traces)
+	{
+		sprintf(path, "%s%s", tracedir, tracename);
+		if (verbose > 1)
+			printf("Streaming tracefile: %s\n", tracename);
+		s = stream_open(path);
+		st->ops = s->num_ops;
+		stream_close(s);
+
+		if (verbose > 1)
+			printf("Checking mm_malloc for correctness, ");
+		st->valid = eval_mm_stream_valid(path, tracenum, ranges);
+		if (!st->valid)
+			return;
+		if (verbose > 1)
+			printf("efficiency, ");
+		st->util = eval_mm_stream_util(path);
+		st->peak_heap = mem_peak_heapsize();
+		st->final_heap = mem_resident();
+#ifdef MM_STATS
+		if (stats_fp != NULL)
+			dump_mm_stats(stats_fp, tracename);
+#endif
+		speed_params.path = path;
+		speed_params.io_secs = 0;
+		speed_params.io_calls = 0;
+		if (verbose > 1)
+			printf("and performance.\n");
+		/* Charge the replay only for the allocator, not for waiting on the reader */
+		st->secs = fsecs(eval_mm_stream_speed, &speed_params);
+		if (speed_params.io_calls > 0)
+			st->secs -= speed_params.io_secs / speed_params.io_calls;
+		if (st->secs < 1e-9)
+			st->secs = 1e-9;
+		if (tlb_report)
+			eval_mm_tlb(&speed_params, &st->tlb);
+		return;
+	}
+
+	trace = read_trace(tracedir, tracename);
+	st->ops = trace->num_ops;
+	if (verbose > 1)
+		printf("Checking mm_malloc for correctness, ");
+	st->valid = eval_mm_valid(trace, tracenum, ranges);
+	if (st->valid)
+	{
+		if (verbose > 1)
+			printf("efficiency, ");
+		st->util = eval_mm_util(trace, tracenum, ranges);
+		st->peak_heap = mem_peak_heapsize();
+		st->final_heap = mem_resident();
+#ifdef MM_STATS
+		if (stats_fp != NULL)
+			dump_mm_stats(stats_fp, tracename);
+		if (layout_fp != NULL)
+			eval_mm_layout(trace, tracename, layout_fp, layout_every);
+#endif
+		speed_params.trace = trace;
+		speed_params.ranges = *ranges;
+		if (verbose > 1)
+			printf("and performance.\n");
+		st->secs = fsecs(eval_mm_speed, &speed_params);
+		if (batch_mode)
+			st->batch_secs = fsecs(eval_mm_batch_speed, &speed_params);
+		if (tlb_report)
+			eval_mm_tlb(&speed_params, &st->tlb);
+		if (latency)
+			st->lat = eval_mm_latency(trace);
+	}
+	free_trace(trace);
+}
+
+/*
+ * eval_mm_parallel - Run each trace in its own forked worker, at most
+ *     jobs at a time. A worker starts from a copy of this process, so
+ *     it has a memlib heap of its own; it leaves its stats_t in a
+ *     shared job_t slot. A worker that dies (e.g. a segfault in mm.c)
+ *     counts as an invalid trace. Timings are only comparable with a
+ *     serial run if jobs does not exceed the idle cores.
+ */
+static void eval_mm_parallel(char **tracefiles, int num_tracefiles, int jobs,
+							 int latency, stats_t *mm_stats)
+{
+	job_t *slots;
+	range_t *ranges = NULL;
+	size_t len = num_tracefiles * sizeof(job_t);
+	int i, next = 0, running = 0, status;
+	pid_t pid;
+
+	slots = mmap(NULL, len, PROT_READ | PROT_WRITE,
+				 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (slots == MAP_FAILED)
+		unix_error("mmap failed in eval_mm_parallel");
+	memset(slots, 0, len);
+
+	while (next < num_tracefiles || running > 0)
+	{
+		if (next < num_tracefiles && running < jobs)
+		{
+			fflush(stdout); /* or the worker would print our buffer again */
+			if ((pid = fork()) < 0)
+				unix_error("fork failed in eval_mm_parallel");
+			if (pid == 0)
+			{
+				job_t *job = &slots[next];
+
+				errors = 0; /* count only this trace's errors */
+				eval_mm_trace(tracefiles[next], next, &ranges, &job->stats,
+							  latency, NULL, NULL, 0);
+				if (job->stats.lat != NULL)
+					job->lat = *job->stats.lat;
+				job->errors = errors;
+				job->done = 1;
+				fflush(stdout);
+				_exit(0);
+			}
+			next++;
+			running++;
+			continue;
+		}
+		if (wait(&status) < 0)
+			unix_error("wait failed in eval_mm_parallel");
+		running--;
+	}
+
+	for (i = 0; i < num_tracefiles; i++)
+	{
+		mm_stats[i] = slots[i].stats;
+		mm_stats[i].lat = NULL;
+		errors += slots[i].errors;
+		if (!slots[i].done)
+		{
+			printf("ERROR [trace %d]: worker for %s did not finish\n",
+				   i, tracefiles[i]);
+			mm_stats[i].valid = 0;
+			errors++;
+		}
+		else if (latency && mm_stats[i].valid)
+		{
+			if ((mm_stats[i].lat = (latency_t *)malloc(sizeof(latency_t))) == NULL)
+				unix_error("malloc failed in eval_mm_parallel");
+			*mm_stats[i].lat = slots[i].lat;
+		}
+	}
+	munmap(slots, len);
+}
+
+/*****************************************************
+ * Routines for tuning the run-time parameters of mm.c
+ *****************************************************/
+
+/*
+ * perf_index - Combine average utilization and throughput into the
+ *     performance index (0-100); p1 and p2 get the two weighted parts
+ */
+static double perf_index(double util, double throughput, double *p1, double *p2)
+{
+	*p1 = UTIL_WEIGHT * util;
+	if (throughput > AVG_LIBC_THRUPUT)
+	{
+		*p2 = (double)(1.0 - UTIL_WEIGHT);
+	}
+	else
+	{
+		*p2 = ((double)(1.0 - UTIL_WEIGHT)) *
+			  (throughput / AVG_LIBC_THRUPUT);
+	}
+	return (*p1 + *p2) * 100.0;
+}
+
+/*
+ * eval_mm_perfindex - Check, measure and time mm.c on all n traces
+ *     with the current parameters; returns the performance index, or
+ *     -1 if some trace is not handled correctly
+ */
+static double eval_mm_perfindex(trace_t **traces, int n, range_t **ranges)
+{
+	speed_t speed_params;
+	double util = 0, ops = 0, secs = 0, p1, p2;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		if (!eval_mm_valid(traces[i], i, ranges))
+			return -1;
+		util += eval_mm_util(traces[i], i, ranges);
+		speed_params.trace = traces[i];
+		speed_params.ranges = *ranges;
+		secs += fsecs(eval_mm_speed, &speed_params);
+		ops += traces[i]->num_ops;
+	}
+	return perf_index(util / n, ops / secs, &p1, &p2);
+}
+
+/*
+ * tune_params - Hill-climb over tune_table: for each field in turn,
+ *     try its other values with everything else fixed and keep any
+ *     that raises the performance index, until a pass changes nothing
+ *     or TUNE_ROUNDS passes are done. The best parameters are left
+ *     set in mm.c and written to path in the format read by -p.
+ */
+static void tune_params(char **tracefiles, int num_tracefiles, char *path)
+{
+	trace_t **traces;
+	range_t *ranges = NULL;
+	mm_params_t best, cand;
+	double best_index, index;
+	int i, k, v, round, evals = 1, improved = 1;
+	FILE *fp;
+
+	if ((traces = (trace_t **)malloc(num_tracefiles * sizeof(trace_t *))) == NULL)
+		unix_error("malloc failed in tune_params");
+	for (i = 0; i < num_tracefiles; i++)
+		traces[i] = read_trace(tracedir, tracefiles[i]);
+
+	mm_get_params(&best);
+	best_index = eval_mm_perfindex(traces, num_tracefiles, &ranges);
+	printf("Tuning on %d traces: start at perf index %.2f\n",
+		   num_tracefiles, best_index);
+
+	for (round = 0; round < TUNE_ROUNDS && improved; round++)
+	{
+		improved = 0;
+		for (k = 0; k < TUNE_PARAMS; k++)
+		{
+			for (v = 0; v < tune_table[k].num_values; v++)
+			{
+				cand = best;
+				if (PARAM(&cand, k) == tune_table[k].values[v])
+					continue;
+				PARAM(&cand, k) = tune_table[k].values[v];
+				if (mm_set_params(&cand) < 0)
+					continue;
+				index = eval_mm_perfindex(traces, num_tracefiles, &ranges);
+				evals++;
+				if (index > best_index + 0.01)
+				{
+					best = cand;
+					best_index = index;
+					improved = 1;
+					printf("  %s=%lu -> %.2f\n", tune_table[k].name,
+						   (unsigned long)PARAM(&cand, k), index);
+				}
+			}
+		}
+	}
+	mm_set_params(&best);
+	printf("Tuned to perf index %.2f after %d runs, saved in %s\n\n",
+		   best_index, evals, path);
+
+	if ((fp = fopen(path, "w")) == NULL)
+		unix_error("ERROR: could not open the -u file");
+	fprintf(fp, "# mdriver -u: perf index %.2f on %d traces\n",
+			best_index, num_tracefiles);
+	write_params(fp, &best);
+	fclose(fp);
+
+	clear_ranges(&ranges);
+	for (i = 0; i < num_tracefiles; i++)
+		free_trace(traces[i]);
+	free(traces);
+}
+
+/*
+ * read_params - Load name=value lines (as written by -u) on top of
+ *     mm.c's current parameters; '#' starts a comment line
+ */
+static void read_params(char *path)
+{
+	FILE *fp;
+	mm_params_t params;
+	char line[MAXLINE], name[64];
+	unsigned long value;
+	int k, linenum = 0;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		unix_error("ERROR: could not open the -p file");
+	mm_get_params(&params);
+	while (fgets(line, MAXLINE, fp) != NULL)
+	{
+		linenum++;
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, " %63[a-z_] = %lu", name, &value) != 2)
+		{
+			sprintf(msg, "ERROR: bad line %d in %s", linenum, path);
+			app_error(msg);
+		}
+		for (k = 0; k < TUNE_PARAMS; k++)
+			if (strcmp(name, tune_table[k].name) == 0)
+				break;
+		if (k == TUNE_PARAMS)
+		{
+			sprintf(msg, "ERROR: unknown parameter %s in %s", name, path);
+			app_error(msg);
+		}
+		PARAM(&params, k) = value;
+	}
+	fclose(fp);
+	if (mm_set_params(&params) < 0)
+	{
+		sprintf(msg, "ERROR: mm_set_params rejected the values in %s", path);
+		app_error(msg);
+	}
+}
+
+/*
+ * write_params - Print every tunable parameter as a name=value line
+ */
+static void write_params(FILE *fp, mm_params_t *params)
+{
+	int k;
+
+	for (k = 0; k < TUNE_PARAMS; k++)
+		fprintf(fp, "%s=%lu\n", tune_table[k].name,
+				(unsigned long)PARAM(params, k));
+}
 
-		case FREE: /* free */
-			free(trace->blocks[trace->ops[i].index]);
-			break;
+/*****************************************
+ * Routines for the benchmark mode (-b)
+ ****************************************/
 
-		default:
-			app_error("invalid operation type  in eval_libc_valid");
+/*
+ * bench_traces - Replay every trace in reps rounds, measuring util and
+ *     throughput in each, and print the medians with their confidence
+ *     intervals. Writes the results to out_path and compares them with
+ *     base_path if given; returns the number of regressions found.
+ */
+static int bench_traces(char **tracefiles, int num_tracefiles, int reps,
+						char *out_path, char *base_path)
+{
+	trace_t **traces;
+	range_t *ranges = NULL;
+	speed_t speed_params;
+	bench_t *bench, *base = NULL, *b;
+	double *kops, *util, secs, ops;
+	int i, k, j, n = num_tracefiles + 1, num_base = 0, regressions = 0;
+	int slower, faster, lost_util, matched = 0;
+	char *verdict;
+
+	traces = (trace_t **)malloc(num_tracefiles * sizeof(trace_t *));
+	bench = (bench_t *)calloc(n, sizeof(bench_t));
+	kops = (double *)malloc((size_t)n * reps * sizeof(double));
+	util = (double *)malloc((size_t)n * reps * sizeof(double));
+	if (traces == NULL || bench == NULL || kops == NULL || util == NULL)
+		unix_error("malloc failed in bench_traces");
+	for (i = 0; i < num_tracefiles; i++)
+		traces[i] = read_trace(tracedir, tracefiles[i]);
+
+	/* One untimed replay each, so no sample pays for cold pages */
+	for (i = 0; i < num_tracefiles; i++)
+	{
+		speed_params.trace = traces[i];
+		eval_mm_speed(&speed_params);
+	}
+
+	/* Samples of trace i are kops[i * reps + k], the whole set is row num_tracefiles */
+	for (k = 0; k < reps; k++)
+	{
+		secs = ops = 0;
+		util[num_tracefiles * reps + k] = 0;
+		for (i = 0; i < num_tracefiles; i++)
+		{
+			util[i * reps + k] = eval_mm_util(traces[i], i, &ranges);
+			speed_params.trace = traces[i];
+			speed_params.ranges = ranges;
+			kops[i * reps + k] = ftimer_clock(eval_mm_speed, &speed_params, BENCH_RUNS);
+			secs += kops[i * reps + k];
+			ops += traces[i]->num_ops;
+			kops[i * reps + k] = traces[i]->num_ops / kops[i * reps + k] / 1e3;
+			util[num_tracefiles * reps + k] += util[i * reps + k] / num_tracefiles;
 		}
+		kops[num_tracefiles * reps + k] = ops / secs / 1e3;
 	}
 
-	return 1;
+	for (i = 0; i < n; i++)
+	{
+		if (i < num_tracefiles)
+		{
+			strncpy(bench[i].name, tracefiles[i], MAXLINE - 1);
+			bench[i].ops = traces[i]->num_ops;
+			bench[n - 1].ops += traces[i]->num_ops;
+		}
+		else
+			strcpy(bench[i].name, "total");
+		bench[i].kops = median_ci(&kops[i * reps], reps);
+		bench[i].util = median_ci(&util[i * reps], reps);
+	}
+	if (base_path != NULL)
+		num_base = read_bench(base_path, &base);
+
+	printf("Benchmark of mm malloc (%d rounds, median and 95%% interval):\n", reps);
+	printf("%-20s%10s%10s%10s%8s", "trace", "Kops", "lo", "hi", "util");
+	if (base != NULL)
+		printf("%10s%8s", "base", "change");
+	printf("\n");
+	for (i = 0; i < n; i++)
+	{
+		b = &bench[i];
+		printf("%-20s%10.1f%10.1f%10.1f%7.2f%%", b->name, b->kops.median,
+			   b->kops.lo, b->kops.hi, b->util.median * 100);
+		if (base == NULL)
+		{
+			printf("\n");
+			continue;
+		}
+		for (j = 0; j < num_base && strcmp(base[j].name, b->name); j++)
+			;
+		if (j == num_base)
+		{
+			printf("%10s%8s  new\n", "-", "-");
+			continue;
+		}
+		/* The totals only compare over the same set of traces */
+		if (i == n - 1 && (matched != num_tracefiles || num_base != n))
+		{
+			printf("%10s%8s  other traces\n", "-", "-");
+			continue;
+		}
+		matched++;
+		slower = b->kops.hi < base[j].kops.lo &&
+				 b->kops.median < base[j].kops.median * (1 - BENCH_TOLERANCE);
+		faster = b->kops.lo > base[j].kops.hi &&
+				 b->kops.median > base[j].kops.median * (1 + BENCH_TOLERANCE);
+		lost_util = b->util.hi < base[j].util.lo &&
+					b->util.median < base[j].util.median - BENCH_UTIL_TOLERANCE;
+		if (slower || lost_util)
+			regressions++;
+		verdict = slower ? (lost_util ? "  SLOWER, LOWER UTIL" : "  SLOWER")
+						 : lost_util ? "  LOWER UTIL" : faster ? "  faster" : "";
+		printf("%10.1f%+7.1f%%%s\n", base[j].kops.median,
+			   (b->kops.median / base[j].kops.median - 1) * 100, verdict);
+	}
+	if (base != NULL)
+		printf("%d regression(s) against %s\n", regressions, base_path);
+	printf("\n");
+
+	if (out_path != NULL)
+		write_bench(out_path, bench, n, reps);
+
+	clear_ranges(&ranges);
+	for (i = 0; i < num_tracefiles; i++)
+		free_trace(traces[i]);
+	free(traces);
+	free(bench);
+	free(base);
+	free(kops);
+	free(util);
+	return regressions;
 }
 
 /*
- * eval_libc_speed - This is the function that is used by fcyc() to
- *    measure the running time of the libc malloc package on the set
- *    of traces.
+ * median_ci - Sort the n samples in x and return their median with a
+ *     95% confidence interval ([min, max] when n is too small for one)
  */
-static void eval_libc_speed(void *ptr)
+static interval_t median_ci(double *x, int n)
 {
-	int i;
-	int index, size, newsize;
-	char *p, *newp, *oldp, *block;
-	trace_t *trace = ((speed_t *)ptr)->trace;
+	interval_t r;
+	double half = 1.96 * sqrt((double)n) / 2;
+	int lo = (int)floor(n / 2.0 - half);
+	int hi = (int)ceil(n / 2.0 + half) - 1;
+
+	qsort(x, n, sizeof(double), cmp_double);
+	r.median = (n % 2) ? x[n / 2] : (x[n / 2 - 1] + x[n / 2]) / 2;
+	r.lo = x[lo < 0 ? 0 : lo];
+	r.hi = x[hi > n - 1 ? n - 1 : hi];
+	return r;
+}
 
-	for (i = 0; i < trace->num_ops; i++)
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * write_bench - Write the benchmark results to path, as CSV if the
+ *     name ends in .csv and as JSON otherwise. Either can be read back
+ *     by read_bench as a baseline: the JSON has one trace per line.
+ */
+static void write_bench(char *path, bench_t *b, int n, int reps)
+{
+	FILE *fp;
+	size_t len = strlen(path);
+	int i, csv = len >= 4 && !strcmp(path + len - 4, ".csv");
+
+	if ((fp = fopen(path, "w")) == NULL)
+		unix_error("ERROR: could not open the -o file");
+	if (csv)
+		fprintf(fp, "trace,ops,kops_median,kops_lo,kops_hi,util_median,util_lo,util_hi\n");
+	else
+		fprintf(fp, "{\"rounds\": %d, \"runs_per_sample\": %d, \"traces\": [\n",
+				reps, BENCH_RUNS);
+	for (i = 0; i < n; i++)
 	{
-		switch (trace->ops[i].type)
+		if (csv)
+			fprintf(fp, "%s,%ld,%.3f,%.3f,%.3f,%.6f,%.6f,%.6f\n",
+					b[i].name, b[i].ops, b[i].kops.median, b[i].kops.lo,
+					b[i].kops.hi, b[i].util.median, b[i].util.lo, b[i].util.hi);
+		else
 		{
-		case ALLOC: /* malloc */
-			index = trace->ops[i].index;
-			size = trace->ops[i].size;
-			if ((p = malloc(size)) == NULL)
-				unix_error("malloc failed in eval_libc_speed");
-			trace->blocks[index] = p;
-			break;
+			fprintf(fp, "  {\"trace\": ");
+			json_string(fp, b[i].name);
+			fprintf(fp, ", \"ops\": %ld, \"kops_median\": %.3f, "
+					"\"kops_lo\": %.3f, \"kops_hi\": %.3f, \"util_median\": %.6f, "
+					"\"util_lo\": %.6f, \"util_hi\": %.6f}%s\n",
+					b[i].ops, b[i].kops.median, b[i].kops.lo,
+					b[i].kops.hi, b[i].util.median, b[i].util.lo, b[i].util.hi,
+					(i < n - 1) ? "," : "");
+		}
+	}
+	if (!csv)
+		fprintf(fp, "]}\n");
+	fclose(fp);
+}
 
-		case REALLOC: /* realloc */
-			index = trace->ops[i].index;
-			newsize = trace->ops[i].size;
-			oldp = trace->blocks[index];
-			if ((newp = realloc(oldp, newsize)) == NULL)
-				unix_error("realloc failed in eval_libc_speed\n");
+/*
+ * json_string - Print str as a quoted JSON string, escaping quotes,
+ *     backslashes and control characters
+ */
+static void json_string(FILE *fp, const char *str)
+{
+	const unsigned char *c;
+
+	fputc('"', fp);
+	for (c = (const unsigned char *)str; *c != '\0'; c++)
+		if (*c == '"' || *c == '\\')
+			fprintf(fp, "\\%c", *c);
+		else if (*c < 0x20)
+			fprintf(fp, "\\u%04x", *c);
+		else
+			fputc(*c, fp);
+	fputc('"', fp);
+}
 
-			trace->blocks[index] = newp;
-			break;
+/*
+ * json_unstring - Copy the JSON string that starts after the opening
+ *     quote at p into out (at most MAXLINE bytes), undoing json_string;
+ *     returns the position after the closing quote, or NULL
+ */
+static char *json_unstring(char *p, char *out)
+{
+	unsigned code;
+	int n = 0;
 
-		case FREE: /* free */
-			index = trace->ops[i].index;
-			block = trace->blocks[index];
-			free(block);
-			break;
+	for (; *p != '"'; p++)
+	{
+		if (*p == '\0' || n == MAXLINE - 1)
+			return NULL;
+		if (*p == '\\')
+		{
+			p++;
+			if (*p == 'u' && sscanf(p + 1, "%4x", &code) == 1)
+			{
+				out[n++] = (char)code;
+				p += 4;
+				continue;
+			}
+			if (*p == '\0')
+				return NULL;
 		}
+		out[n++] = *p;
+	}
+	out[n] = '\0';
+	return p + 1;
+}
+
+/*
+ * read_bench - Load the results of a file written by write_bench into
+ *     a malloc'd array *b; returns the number of traces read
+ */
+static int read_bench(char *path, bench_t **b)
+{
+	FILE *fp;
+	char line[MAXLINE];
+	int n = 0, max = 16, got;
+	bench_t *r;
+	char *p;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		unix_error("ERROR: could not open the -B file");
+	if ((*b = (bench_t *)malloc(max * sizeof(bench_t))) == NULL)
+		unix_error("malloc failed in read_bench");
+	while (fgets(line, MAXLINE, fp) != NULL)
+	{
+		if (n == max && (*b = (bench_t *)realloc(*b, (max *= 2) * sizeof(bench_t))) == NULL)
+			unix_error("realloc failed in read_bench");
+		r = &(*b)[n];
+		if ((p = strstr(line, "{\"trace\": \"")) != NULL)
+			got = (p = json_unstring(p + strlen("{\"trace\": \""), r->name)) == NULL ? 0 :
+				  1 + sscanf(p, ", \"ops\": %ld, \"kops_median\": %lf, "
+							 "\"kops_lo\": %lf, \"kops_hi\": %lf, \"util_median\": %lf, "
+							 "\"util_lo\": %lf, \"util_hi\": %lf",
+							 &r->ops, &r->kops.median, &r->kops.lo, &r->kops.hi,
+							 &r->util.median, &r->util.lo, &r->util.hi);
+		else
+			got = sscanf(line, "%[^,],%ld,%lf,%lf,%lf,%lf,%lf,%lf",
+						 r->name, &r->ops, &r->kops.median, &r->kops.lo, &r->kops.hi,
+						 &r->util.median, &r->util.lo, &r->util.hi);
+		if (got == 8)
+			n++;
 	}
+	fclose(fp);
+	if (n == 0)
+		app_error("ERROR: the -B file holds no benchmark results");
+	return n;
 }
 
 /*************************************
@@ -1026,6 +3535,79 @@ static void printresults(int n, stats_t *stats)
 	}
 }
 
+/*
+ * printheap - prints the peak and final resident heap of each trace's
+ *     util run next to its utilization
+ */
+static void printheap(int n, stats_t *stats)
+{
+	int i;
+	size_t peak = 0;
+	size_t final = 0;
+
+	printf("%5s%6s%10s%10s%7s\n",
+		   "trace", "util", "peak KB", "final KB", "kept");
+	for (i = 0; i < n; i++)
+	{
+		if (stats[i].valid)
+		{
+			printf("%2d%8.0f%%%10.1f%10.1f%6.0f%%\n",
+				   i,
+				   stats[i].util * 100.0,
+				   stats[i].peak_heap / 1024.0,
+				   stats[i].final_heap / 1024.0,
+				   100.0 * stats[i].final_heap / stats[i].peak_heap);
+			peak += stats[i].peak_heap;
+			final += stats[i].final_heap;
+		}
+		else
+		{
+			printf("%2d%9s%10s%10s%7s\n", i, "-", "-", "-", "-");
+		}
+	}
+	if (peak > 0)
+		printf("%-7s%14.1f%10.1f%6.0f%%\n",
+			   "Total", peak / 1024.0, final / 1024.0, 100.0 * final / peak);
+}
+
+/*
+ * printbatch - prints each trace's throughput with one call per
+ *     request next to that of the batched replay (-m)
+ */
+static void printbatch(int n, stats_t *stats)
+{
+	int i;
+	double secs = 0;
+	double batch_secs = 0;
+	double ops = 0;
+
+	printf("%5s%8s%10s%12s%9s\n",
+		   "trace", "ops", "Kops", "batch Kops", "speedup");
+	for (i = 0; i < n; i++)
+	{
+		if (stats[i].valid)
+		{
+			printf("%2d%11.0f%10.0f%12.0f%8.2fx\n",
+				   i,
+				   stats[i].ops,
+				   (stats[i].ops / 1e3) / stats[i].secs,
+				   (stats[i].ops / 1e3) / stats[i].batch_secs,
+				   stats[i].secs / stats[i].batch_secs);
+			secs += stats[i].secs;
+			batch_secs += stats[i].batch_secs;
+			ops += stats[i].ops;
+		}
+		else
+		{
+			printf("%2d%11s%10s%12s%9s\n", i, "-", "-", "-", "-");
+		}
+	}
+	if (batch_secs > 0)
+		printf("%-7s%6.0f%10.0f%12.0f%8.2fx\n",
+			   "Total", ops, (ops / 1e3) / secs, (ops / 1e3) / batch_secs,
+			   secs / batch_secs);
+}
+
 /*
  * app_error - Report an arbitrary application error
  */
@@ -1053,19 +3635,339 @@ void malloc_error(int tracenum, int opnum, char *msg)
 	printf("ERROR [trace %d, line %d]: %s\n", tracenum, LINENUM(opnum), msg);
 }
 
+/*
+ * printlatency - prints latency percentiles of each request type of
+ *     each trace's -L replay, first over all sizes and then for every
+ *     size class that the trace actually requested
+ */
+static void printlatency(int n, stats_t *stats)
+{
+	int i, op, cls, b;
+	unsigned long long all[LAT_BUCKETS];
+	unsigned long long count, max;
+
+	printf("%5s%8s%7s%9s%8s%8s%8s%8s%9s\n",
+		   "trace", "op", "size", "count", "p50", "p90", "p99", "p999", "max");
+	for (i = 0; i < n; i++)
+	{
+		if (stats[i].lat == NULL)
+		{
+			printf("%2d%11s\n", i, "-");
+			continue;
+		}
+		for (op = 0; op < LAT_OPS; op++)
+		{
+			/* Merge the size classes for the "all" row */
+			memset(all, 0, sizeof(all));
+			count = max = 0;
+			for (cls = 0; cls < LAT_SIZES; cls++)
+			{
+				for (b = 0; b < LAT_BUCKETS; b++)
+					all[b] += stats[i].lat->hist[op][cls][b];
+				count += stats[i].lat->count[op][cls];
+				if (stats[i].lat->max[op][cls] > max)
+					max = stats[i].lat->max[op][cls];
+			}
+			if (count == 0)
+				continue;
+			printf("%2d%11s%7s%9llu%8llu%8llu%8llu%8llu%9llu\n",
+				   i, lat_op_names[op], "all", count,
+				   lat_percentile(all, count, max, 0.50),
+				   lat_percentile(all, count, max, 0.90),
+				   lat_percentile(all, count, max, 0.99),
+				   lat_percentile(all, count, max, 0.999),
+				   max);
+			for (cls = 0; cls < LAT_SIZES; cls++)
+			{
+				unsigned long long *hist = stats[i].lat->hist[op][cls];
+
+				count = stats[i].lat->count[op][cls];
+				max = stats[i].lat->max[op][cls];
+				if (count == 0)
+					continue;
+				printf("%13s%7s%9llu%8llu%8llu%8llu%8llu%9llu\n",
+					   "", lat_size_names[cls], count,
+					   lat_percentile(hist, count, max, 0.50),
+					   lat_percentile(hist, count, max, 0.90),
+					   lat_percentile(hist, count, max, 0.99),
+					   lat_percentile(hist, count, max, 0.999),
+					   max);
+			}
+		}
+	}
+}
+
+/*
+ * printtlb - Print the dTLB counts of each trace (-d): misses per
+ *     thousand requests is the number to compare between builds,
+ *     e.g. with and without HUGE=1
+ */
+static void printtlb(int n, stats_t *stats)
+{
+	int i, counted = 0;
+	tlb_t *t;
+
+	printf("%5s%10s%12s%12s%10s%7s%9s%9s\n",
+		   "trace", "ops", "loads", "misses", "miss/Kop", "miss%", "Kops", "huge MB");
+	for (i = 0; i < n; i++)
+	{
+		t = &stats[i].tlb;
+		if (!stats[i].valid || t->secs == 0)
+		{
+			printf("%2d%13s\n", i, "-");
+			continue;
+		}
+		printf("%2d%13.0f", i, stats[i].ops);
+		if (t->loads >= 0)
+			printf("%12lld", t->loads);
+		else
+			printf("%12s", "-");
+		if (t->misses >= 0)
+		{
+			printf("%12lld%10.2f", t->misses, 1000.0 * t->misses / stats[i].ops);
+			counted++;
+		}
+		else
+			printf("%12s%10s", "-", "-");
+		if (t->loads > 0 && t->misses >= 0)
+			printf("%6.2f%%", 100.0 * t->misses / t->loads);
+		else
+			printf("%7s", "-");
+		printf("%9.0f%9.1f\n", stats[i].ops / t->secs / 1e3,
+			   t->huge_bytes / (1024.0 * 1024.0));
+	}
+	if (counted == 0)
+		printf("(no dTLB counters: perf_event_open failed, e.g. in a VM "
+			   "without a PMU or under perf_event_paranoid > 2)\n");
+}
+
+/*
+ * lat_percentile - Smallest latency that at least a fraction q of the
+ *     count requests in hist did not exceed. Reports the top of the
+ *     bucket the percentile falls in, capped at the exact maximum.
+ */
+static unsigned long long lat_percentile(unsigned long long *hist,
+										 unsigned long long count,
+										 unsigned long long max, double q)
+{
+	unsigned long long rank = (unsigned long long)(q * count + 0.999999);
+	unsigned long long seen = 0;
+	unsigned long long top;
+	int b, shift;
+
+	for (b = 0; b < LAT_BUCKETS; b++)
+	{
+		seen += hist[b];
+		if (seen >= rank && seen > 0)
+			break;
+	}
+	if (b < 2 * LAT_SUB)
+		top = b;
+	else
+	{
+		shift = b / LAT_SUB - 1;
+		top = ((unsigned long long)(LAT_SUB + b % LAT_SUB) << shift) +
+			  (1ULL << shift) - 1;
+	}
+	return (top < max) ? top : max;
+}
+
+#ifdef MM_STATS
+/*
+ * dump_mm_stats - append one JSON object with the allocator's internal
+ *     stats after the util run of tracename. The objects of all traces
+ *     together form one JSON array; the caller writes the brackets.
+ *     Traces that fail validation write no object, so the separator
+ *     depends on how many objects came before, not on the trace number.
+ */
+static void dump_mm_stats(FILE *fp, char *tracename)
+{
+	static int objects = 0;
+	mm_stats_t s;
+
+	mm_stats(&s);
+	fprintf(fp, "%s\n\t{\n\t\t\"trace\": ", objects++ ? "," : "");
+	json_string(fp, tracename);
+
+#define JSON_COUNT(f) fprintf(fp, ",\n\t\t\"%s\": %lu", #f, s.f)
+#define JSON_ARRAY(f) dump_json_array(fp, #f, s.f, sizeof(s.f) / sizeof(s.f[0]))
+	JSON_COUNT(fit_calls);
+	JSON_COUNT(fit_misses);
+	JSON_COUNT(fit_walk_total);
+	JSON_ARRAY(fit_walk_hist);
+	JSON_COUNT(insert_calls);
+	JSON_COUNT(insert_walk_total);
+	JSON_ARRAY(insert_walk_hist);
+	JSON_COUNT(place_calls);
+	JSON_COUNT(split_low);
+	JSON_COUNT(split_high);
+	JSON_COUNT(no_split);
+	JSON_ARRAY(coalesce_cases);
+	JSON_COUNT(extend_calls);
+	JSON_COUNT(extend_bytes);
+	JSON_COUNT(new_regions);
+	JSON_COUNT(trim_calls);
+	JSON_COUNT(trim_bytes);
+	JSON_COUNT(release_calls);
+	JSON_COUNT(release_bytes);
+	JSON_COUNT(quick_hits);
+	JSON_COUNT(quick_pushes);
+	JSON_COUNT(quick_consolidations);
+	JSON_COUNT(deferred_frees);
+	JSON_COUNT(deferred_hits);
+	JSON_COUNT(deferred_drained);
+	JSON_COUNT(realloc_in_place);
+	JSON_COUNT(realloc_grew_top);
+	JSON_COUNT(realloc_grew_back);
+	JSON_COUNT(realloc_shrunk);
+	JSON_COUNT(realloc_moved);
+	JSON_COUNT(slab_allocs);
+	JSON_COUNT(large_allocs);
+	JSON_COUNT(quick_blocks);
+	JSON_ARRAY(used_blocks);
+	JSON_ARRAY(used_bytes);
+	JSON_ARRAY(free_blocks);
+	JSON_ARRAY(free_bytes);
+#undef JSON_COUNT
+#undef JSON_ARRAY
+
+	fprintf(fp, "\n\t}");
+}
+
+/*
+ * dump_json_array - print ,"name": [v0, v1, ...] for dump_mm_stats,
+ *     dropping trailing zeros so the sparse class arrays stay short
+ */
+static void dump_json_array(FILE *fp, char *name, unsigned long *v, int n)
+{
+	int i;
+
+	while (n > 0 && v[n - 1] == 0)
+		n--;
+	fprintf(fp, ",\n\t\t\"%s\": [", name);
+	for (i = 0; i < n; i++)
+		fprintf(fp, "%s%lu", (i == 0) ? "" : ", ", v[i]);
+	fprintf(fp, "]");
+}
+
+/*
+ * eval_mm_layout - Replay the trace once more with a heap-layout
+ *     snapshot every `every` requests and one after the last, appended
+ *     to fp as CSV rows of a time series. The header row goes out
+ *     before the first row written to fp.
+ */
+static void eval_mm_layout(trace_t *trace, char *tracename, FILE *fp, int every)
+{
+	int i, b, index, size;
+	long payload = 0; /* bytes the trace has live right now */
+	char *p;
+
+	if (ftell(fp) == 0)
+	{
+		fprintf(fp, "trace,op,heap,payload,used,overhead,quick,free,"
+					"free_blocks,largest_free,ext_frag,util");
+		for (b = 0; b < MM_LAYOUT_BUCKETS; b++)
+			fprintf(fp, ",free_%lu", 16UL << b);
+		fprintf(fp, "\n");
+	}
+
+	mem_reset_brk();
+	if (mm_init() < 0)
+		app_error("mm_init failed in eval_mm_layout");
+
+	for (i = 0; i < trace->num_ops; i++)
+	{
+		index = trace->ops[i].index;
+		size = trace->ops[i].size;
+		switch (trace->ops[i].type)
+		{
+		case ALLOC: /* mm_malloc */
+			if ((p = mm_malloc(size)) == NULL)
+				app_error("mm_malloc failed in eval_mm_layout");
+			trace->blocks[index] = p;
+			trace->block_sizes[index] = size;
+			payload += size;
+			break;
+
+		case REALLOC: /* mm_realloc */
+			if ((p = mm_realloc(trace->blocks[index], size)) == NULL)
+				app_error("mm_realloc failed in eval_mm_layout");
+			payload += size - (long)trace->block_sizes[index];
+			trace->blocks[index] = p;
+			trace->block_sizes[index] = size;
+			break;
+
+		case FREE: /* mm_free */
+			mm_free(trace->blocks[index]);
+			payload -= trace->block_sizes[index];
+			break;
+
+		default:
+			app_error("Nonexistent request type in eval_mm_layout");
+		}
+		if ((i + 1) % every == 0 && i + 1 < trace->num_ops)
+			layout_snapshot(fp, tracename, i + 1, payload);
+	}
+	layout_snapshot(fp, tracename, trace->num_ops, payload);
+}
+
+/*
+ * layout_snapshot - write one CSV row describing the heap right after
+ *     request opnum. Overhead is what allocated blocks take beyond the
+ *     live payload (headers, alignment and minimum-size padding) plus
+ *     the region boundary tags. External fragmentation is the share of
+ *     free memory outside the largest free block.
+ */
+static void layout_snapshot(FILE *fp, char *tracename, int opnum, long payload)
+{
+	mm_layout_t l;
+	size_t heap = mem_heapsize();
+	long overhead;
+	int b;
+
+	mm_layout(&l);
+	overhead = (long)(l.used_bytes - l.quick_bytes) - payload + l.overhead_bytes;
+	fprintf(fp, "%s,%d,%lu,%ld,%lu,%ld,%lu,%lu,%lu,%lu,%.4f,%.4f",
+			tracename, opnum, (unsigned long)heap, payload, l.used_bytes,
+			overhead, l.quick_bytes, l.free_bytes, l.free_blocks,
+			l.largest_free,
+			l.free_bytes ? 1.0 - (double)l.largest_free / l.free_bytes : 0.0,
+			heap ? (double)payload / heap : 0.0);
+	for (b = 0; b < MM_LAYOUT_BUCKETS; b++)
+		fprintf(fp, ",%lu", l.free_hist[b]);
+	fprintf(fp, "\n");
+}
+#endif
+
 /*
  * usage - Explain the command line arguments
  */
 static void usage(void)
 {
-	fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+	fprintf(stderr, "Usage: mdriver [-hvVadlLmr] [-b <n> [-o <file>] [-B <file>]] [-c <mode>] [-f <file>] [-t <dir>] [-j <file>] [-J <n>] [-s <file> [-S <n>]] [-P <policy>] [-p <file>] [-u <file>] [-T <n>]\n");
 	fprintf(stderr, "Options\n");
 	fprintf(stderr, "\t-a         Don't check the team structure.\n");
+	fprintf(stderr, "\t-b <n>     Benchmark: replay every trace in <n> timed rounds.\n");
+	fprintf(stderr, "\t-B <file>  Compare the benchmark with <file>; exit 2 if it regressed.\n");
+	fprintf(stderr, "\t-c <mode>  Check the heap after each request: full, incr or every <n>th.\n");
+	fprintf(stderr, "\t-d         Count dTLB misses of each trace with perf counters.\n");
 	fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
 	fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
 	fprintf(stderr, "\t-h         Print this message.\n");
+	fprintf(stderr, "\t-j <file>  Write mm_stats() of each trace to <file> as JSON.\n");
+	fprintf(stderr, "\t-J <n>     Run up to <n> traces at once in worker processes.\n");
 	fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+	fprintf(stderr, "\t-m         Serve same-size runs of requests through mm_malloc_batch / mm_free_batch.\n");
+	fprintf(stderr, "\t-r         Stream the traces from disk instead of loading them.\n");
+	fprintf(stderr, "\t-s <file>  Write heap-layout snapshots to <file> as CSV.\n");
+	fprintf(stderr, "\t-S <n>     Take a snapshot every <n> requests (default 1000).\n");
+	fprintf(stderr, "\t-L         Time every request and print latency percentiles.\n");
+	fprintf(stderr, "\t-o <file>  Write the benchmark to <file>, as CSV if it ends in .csv.\n");
+	fprintf(stderr, "\t-p <file>  Load mm.c parameters from <file> (as written by -u).\n");
+	fprintf(stderr, "\t-P <name>  Use allocation policy <name> (best, good, first, ...).\n");
 	fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+	fprintf(stderr, "\t-u <file>  Tune mm.c parameters on the traces, save the best in <file>.\n");
+	fprintf(stderr, "\t-T <n>     Also replay the traces on up to <n> threads at once, freeing own and neighbour blocks.\n");
 	fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
 	fprintf(stderr, "\t-V         Print additional debug info.\n");
 }
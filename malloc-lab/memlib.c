@@ -2,7 +2,39 @@
  * memlib.c - a module that simulates the memory system.  Needed because it 
  *            allows us to interleave calls from the student's malloc package 
  *            with the system's malloc package in libc.
+ *
+ * Two backing stores are available:
+ *   MEMLIB_ARENA (default) - one MAX_HEAP byte block from malloc.
+ *   MEMLIB_MMAP            - up to MAX_REGIONS anonymous mappings of
+ *                            REGION_RESERVE bytes each. Address space is
+ *                            reserved up front and committed lazily in
+ *                            COMMIT_CHUNK steps as the brk grows. When the
+ *                            current region is full, mem_sbrk opens a new
+ *                            region that is in general NOT adjacent to the
+ *                            previous one; callers detect this by comparing
+ *                            the returned address with the old brk.
+ *                            Side regions (mem_region_reserve) are extra
+ *                            reservations with their own brk, apart from
+ *                            the sbrk heap, for allocator tiers that want
+ *                            a contiguous range of their own.
+ *                            Mappings (mem_map) are single blocks with no
+ *                            brk, which mem_remap can grow or shrink.
+ *
+ * mem_sbrk accepts negative increments (down to the start of the current
+ * region) so the allocator can trim its heap, or give back a fresh
+ * region it cannot use. Under MEMLIB_MMAP the pages
+ * given back, and any interior pages passed to mem_release, are dropped
+ * with madvise(MADV_DONTNEED); mem_resident reports what is still backed.
+ *
+ * MEMLIB_HUGE (with MEMLIB_MMAP) backs the regions with 2 MB pages:
+ * every reservation starts on a HUGE_PAGE_SIZE boundary and is marked
+ * MADV_HUGEPAGE, so the kernel can fault in transparent hugepages, and
+ * pages are only released in whole hugepages, since dropping part of
+ * one would split it. MEMLIB_HUGETLB commits each hugepage as an
+ * explicit hugetlbfs page (MAP_HUGETLB) from the vm.nr_hugepages pool
+ * instead, and a transparent one once the pool is used up.
  */
+#define _GNU_SOURCE             /* mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -14,10 +46,487 @@
 #include "memlib.h"
 #include "config.h"
 
+#ifdef MEMLIB_MMAP
+
+/* One reserved range of virtual memory */
+typedef struct {
+    char *start;      /* first byte of the region */
+    char *brk;        /* first byte past the part handed out by mem_sbrk */
+    char *committed;  /* first byte past the readable/writable part */
+    char *end;        /* first byte past the reservation */
+} region_t;
+
+/* private variables */
+static region_t regions[MAX_REGIONS];
+static int num_regions = 0;   /* regions[num_regions-1] is the current one */
+static region_t sides[MAX_SIDE_REGIONS];
+static int num_sides = 0;
+static region_t maps[MAX_MAPPINGS];  /* mem_map blocks: brk == end */
+static int num_maps = 0;
+static size_t heap_total = 0; /* sum of (brk - start) over all regions */
+static size_t heap_peak = 0;  /* largest heap_total since the last reset */
+
+static int region_map(region_t *r, size_t reserve);
+#ifdef MEMLIB_HUGE
+static char *huge_reserve(size_t reserve);
+#endif
+static void *region_sbrk(region_t *r, int incr);
+static int region_commit(region_t *r, char *new_brk);
+static void release_pages(char *lo, char *hi);
+static region_t *map_find(void *p);
+static size_t region_resident(region_t *r);
+
+/*
+ * mem_init - reserve the first region of the heap
+ */
+void mem_init(void)
+{
+    num_regions = num_sides = 0;
+    heap_total = heap_peak = 0;
+    if (region_map(&regions[0], REGION_RESERVE) < 0) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
+	exit(1);
+    }
+    num_regions = 1;
+}
+
+/*
+ * mem_deinit - unmap every region
+ */
+void mem_deinit(void)
+{
+    int i;
+
+    for (i = 0; i < num_regions; i++)
+	munmap(regions[i].start, regions[i].end - regions[i].start);
+    for (i = 0; i < num_sides; i++)
+	munmap(sides[i].start, sides[i].end - sides[i].start);
+    for (i = 0; i < num_maps; i++)
+	munmap(maps[i].start, maps[i].end - maps[i].start);
+    num_regions = num_sides = num_maps = 0;
+}
+
+/*
+ * mem_reset_brk - reset the simulated brk pointer to make an empty heap.
+ *    Extra regions, side regions and mappings are unmapped. The first region
+ *    keeps its committed pages so that back-to-back timing runs don't
+ *    pay for page faults.
+ */
+void mem_reset_brk()
+{
+    int i;
+
+    for (i = 1; i < num_regions; i++)
+	munmap(regions[i].start, regions[i].end - regions[i].start);
+    for (i = 0; i < num_sides; i++)
+	munmap(sides[i].start, sides[i].end - sides[i].start);
+    for (i = 0; i < num_maps; i++)
+	munmap(maps[i].start, maps[i].end - maps[i].start);
+    num_regions = 1;
+    num_sides = num_maps = 0;
+    regions[0].brk = regions[0].start;
+    heap_total = heap_peak = 0;
+}
+
+/*
+ * mem_sbrk - extends the heap by incr bytes and returns the start
+ *    address of the new area. If the current region can't hold incr
+ *    more bytes, the area is the start of a fresh region. A negative
+ *    incr shrinks the current region and releases the pages above
+ *    the new brk; a region other than the first that shrinks back to
+ *    empty is unmapped, so the caller can undo opening a region it
+ *    cannot use.
+ */
+void *mem_sbrk(int incr)
+{
+    region_t *r = &regions[num_regions - 1];
+    void *old_brk;
+
+    if (incr > 0 && (size_t)(r->end - r->brk) < (size_t)incr) {
+	if (num_regions == MAX_REGIONS || (size_t)incr > REGION_RESERVE ||
+	    region_map(&regions[num_regions], REGION_RESERVE) < 0)
+	    goto fail;
+	r = &regions[num_regions++];
+    }
+
+    if ((old_brk = region_sbrk(r, incr)) != NULL) {
+	if (r->brk == r->start && num_regions > 1) {
+	    munmap(r->start, r->end - r->start);
+	    num_regions--;
+	}
+	return old_brk;
+    }
+
+ fail:
+    errno = ENOMEM;
+    fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
+    return (void *)-1;
+}
+
+/*
+ * mem_region_reserve - reserve a side region of reserve bytes and
+ *    return its start, which also serves as its handle. The region
+ *    starts out empty; grow it with mem_region_sbrk.
+ */
+void *mem_region_reserve(size_t reserve)
+{
+    if (num_sides == MAX_SIDE_REGIONS || region_map(&sides[num_sides], reserve) < 0)
+	return NULL;
+    return (void *)sides[num_sides++].start;
+}
+
+/*
+ * mem_region_sbrk - mem_sbrk for the side region starting at base.
+ *    Never opens a new region; returns (void *)-1 when it is full.
+ */
+void *mem_region_sbrk(void *base, int incr)
+{
+    void *old_brk;
+    int i;
+
+    for (i = 0; i < num_sides; i++)
+	if (sides[i].start == (char *)base) {
+	    if ((old_brk = region_sbrk(&sides[i], incr)) != NULL)
+		return old_brk;
+	    break;
+	}
+    errno = ENOMEM;
+    return (void *)-1;
+}
+
+/*
+ * mem_map - map len bytes of fresh zeroed memory outside the sbrk heap
+ *    and return its (page-aligned) start, or (void *)-1
+ */
+void *mem_map(size_t len)
+{
+    region_t *r;
+    char *start;
+
+    if (num_maps == MAX_MAPPINGS)
+	goto fail;
+    start = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (start == MAP_FAILED)
+	goto fail;
+#ifdef MEMLIB_HUGE
+    madvise(start, len, MADV_HUGEPAGE);
+#endif
+
+    r = &maps[num_maps++];
+    r->start = start;
+    r->brk = r->committed = r->end = start + len;
+    heap_total += len;
+    if (heap_total > heap_peak)
+	heap_peak = heap_total;
+    return (void *)start;
+
+ fail:
+    errno = ENOMEM;
+    return (void *)-1;
+}
+
+/*
+ * mem_unmap - give back a mapping returned by mem_map or mem_remap
+ */
+void mem_unmap(void *p)
+{
+    region_t *r = map_find(p);
+
+    if (r == NULL)
+	return;
+    munmap(r->start, r->end - r->start);
+    heap_total -= r->end - r->start;
+    *r = maps[--num_maps];
+}
+
+/*
+ * mem_remap - resize the mapping at p to len bytes without copying,
+ *    moving it if the kernel has to. Returns the new start or (void *)-1.
+ */
+void *mem_remap(void *p, size_t len)
+{
+    region_t *r = map_find(p);
+    size_t old_len;
+    char *start;
+
+    if (r == NULL)
+	goto fail;
+    old_len = r->end - r->start;
+    start = mremap(r->start, old_len, len, MREMAP_MAYMOVE);
+    if (start == MAP_FAILED)
+	goto fail;
+
+    r->start = start;
+    r->brk = r->committed = r->end = start + len;
+    heap_total += len - old_len;
+    if (heap_total > heap_peak)
+	heap_peak = heap_total;
+    return (void *)start;
+
+ fail:
+    errno = ENOMEM;
+    return (void *)-1;
+}
+
+/*
+ * mem_heap_lo - return address of the first heap byte
+ */
+void *mem_heap_lo()
+{
+    return (void *)regions[0].start;
+}
+
+/*
+ * mem_heap_hi - return address of last heap byte (in the current region)
+ */
+void *mem_heap_hi()
+{
+    return (void *)(regions[num_regions - 1].brk - 1);
+}
+
+/*
+ * mem_heapsize() - returns the heap size in bytes, summed over regions
+ */
+size_t mem_heapsize()
+{
+    return heap_total;
+}
+
+/*
+ * mem_peak_heapsize() - returns the largest heap size since the last reset
+ */
+size_t mem_peak_heapsize()
+{
+    return heap_peak;
+}
+
+/*
+ * mem_release - tell the OS it may reclaim the whole pages inside
+ *    [lo, lo+len). The bytes stay part of the heap and read as zero
+ *    the next time they are touched.
+ */
+void mem_release(void *lo, size_t len)
+{
+    release_pages((char *)lo, (char *)lo + len);
+}
+
+/*
+ * mem_resident() - returns the number of heap bytes backed by physical
+ *    memory, in whole pages
+ */
+size_t mem_resident()
+{
+    size_t resident = 0;
+    int i;
+
+    for (i = 0; i < num_regions; i++)
+	resident += region_resident(&regions[i]);
+    for (i = 0; i < num_sides; i++)
+	resident += region_resident(&sides[i]);
+    for (i = 0; i < num_maps; i++)
+	resident += region_resident(&maps[i]);
+    return resident;
+}
+
+/*
+ * mem_heap_limit() - returns the largest heap mem_sbrk can ever hand out
+ */
+size_t mem_heap_limit()
+{
+    return (size_t)MAX_REGIONS * REGION_RESERVE;
+}
+
+/*
+ * mem_in_heap - returns true if [lo, hi] lies inside a single region
+ */
+int mem_in_heap(void *lo, void *hi)
+{
+    int i;
+
+    for (i = 0; i < num_regions; i++)
+	if ((char *)lo >= regions[i].start && (char *)hi < regions[i].brk)
+	    return 1;
+    for (i = 0; i < num_sides; i++)
+	if ((char *)lo >= sides[i].start && (char *)hi < sides[i].brk)
+	    return 1;
+    for (i = 0; i < num_maps; i++)
+	if ((char *)lo >= maps[i].start && (char *)hi < maps[i].brk)
+	    return 1;
+    return 0;
+}
+
+/*
+ * release_pages - madvise(DONTNEED) every whole page (hugepage under
+ *    MEMLIB_HUGE) inside [lo, hi)
+ */
+static void release_pages(char *lo, char *hi)
+{
+    size_t pagesize = mem_hugepagesize();
+    char *start = (char *)(((size_t)lo + pagesize - 1) & ~(pagesize - 1));
+    char *end = (char *)((size_t)hi & ~(pagesize - 1));
+
+    if (start < end)
+	madvise(start, (size_t)(end - start), MADV_DONTNEED);
+}
+
+/*
+ * map_find - the mapping that starts at p, or NULL
+ */
+static region_t *map_find(void *p)
+{
+    int i;
+
+    for (i = num_maps - 1; i >= 0; i--)
+	if (maps[i].start == (char *)p)
+	    return &maps[i];
+    return NULL;
+}
+
+/*
+ * region_resident - bytes of [r->start, r->brk) backed by physical pages
+ */
+static size_t region_resident(region_t *r)
+{
+    size_t pagesize = mem_pagesize();
+    size_t npages = ((size_t)(r->brk - r->start) + pagesize - 1) / pagesize;
+    size_t resident = 0;
+    size_t j;
+    unsigned char *vec;
+
+    if (npages == 0 || (vec = malloc(npages)) == NULL)
+	return 0;
+    if (mincore(r->start, npages * pagesize, vec) == 0)
+	for (j = 0; j < npages; j++)
+	    if (vec[j] & 1)
+		resident += pagesize;
+    free(vec);
+    return resident;
+}
+
+/*
+ * region_map - reserve reserve bytes of address space for r
+ */
+static int region_map(region_t *r, size_t reserve)
+{
+    char *start;
+
+#ifdef MEMLIB_HUGE
+    reserve = (reserve + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+    if ((start = huge_reserve(reserve)) == NULL)
+	return -1;
+#else
+    start = mmap(NULL, reserve, PROT_NONE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (start == MAP_FAILED)
+	return -1;
+#endif
+
+    r->start = r->brk = r->committed = start;
+    r->end = start + reserve;
+    return 0;
+}
+
+#ifdef MEMLIB_HUGE
+/*
+ * huge_reserve - reserve bytes of address space starting on a
+ *    HUGE_PAGE_SIZE boundary, advised for transparent hugepages:
+ *    an over-sized mapping with the unaligned ends cut off.
+ *    Returns NULL on failure.
+ */
+static char *huge_reserve(size_t reserve)
+{
+    char *start, *aligned;
+    size_t lead;
+
+    start = mmap(NULL, reserve + HUGE_PAGE_SIZE, PROT_NONE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (start == MAP_FAILED)
+	return NULL;
+    aligned = (char *)(((size_t)start + HUGE_PAGE_SIZE - 1) &
+		       ~(size_t)(HUGE_PAGE_SIZE - 1));
+    lead = (size_t)(aligned - start);
+    if (lead > 0)
+	munmap(start, lead);
+    munmap(aligned + reserve, HUGE_PAGE_SIZE - lead);
+    madvise(aligned, reserve, MADV_HUGEPAGE);
+    return aligned;
+}
+#endif
+
+/*
+ * region_sbrk - move r's brk by incr bytes, committing new pages or
+ *    releasing old ones, and return the old brk (NULL on failure)
+ */
+static void *region_sbrk(region_t *r, int incr)
+{
+    char *old_brk = r->brk;
+
+    if (incr < 0) {
+	if ((size_t)-(long)incr > (size_t)(r->brk - r->start))
+	    return NULL;
+	r->brk += incr;
+	heap_total += incr;
+	release_pages(r->brk, old_brk);
+	return (void *)old_brk;
+    }
+
+    if ((size_t)(r->end - r->brk) < (size_t)incr ||
+	region_commit(r, r->brk + incr) < 0)
+	return NULL;
+    r->brk += incr;
+    heap_total += incr;
+    if (heap_total > heap_peak)
+	heap_peak = heap_total;
+    return (void *)old_brk;
+}
+
+/*
+ * region_commit - make sure r is readable/writable up to new_brk,
+ *    growing the committed part in COMMIT_CHUNK steps
+ */
+static int region_commit(region_t *r, char *new_brk)
+{
+    size_t len;
+
+    if (new_brk <= r->committed)
+	return 0;
+
+    len = (size_t)(new_brk - r->committed);
+    len = (len + COMMIT_CHUNK - 1) / COMMIT_CHUNK * COMMIT_CHUNK;
+    if (len > (size_t)(r->end - r->committed))
+	len = (size_t)(r->end - r->committed);
+
+#ifdef MEMLIB_HUGETLB
+    /*
+     * The kernel reserves the pool pages of a MAP_HUGETLB mapping when
+     * it is made, so an empty pool fails here rather than with SIGBUS
+     * on first touch. The fallback remaps the range as normal memory.
+     */
+    if (mmap(r->committed, len, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0) != MAP_FAILED) {
+	r->committed += len;
+	return 0;
+    }
+    if (mmap(r->committed, len, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED)
+	return -1;
+    madvise(r->committed, len, MADV_HUGEPAGE);
+#else
+    if (mprotect(r->committed, len, PROT_READ | PROT_WRITE) < 0)
+	return -1;
+#endif
+    r->committed += len;
+    return 0;
+}
+
+#else /* MEMLIB_ARENA */
+
 /* private variables */
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
+static char *mem_peak_brk;   /* highest brk since the last reset */
 
 /* 
  * mem_init - initialize the memory system model
@@ -32,6 +541,7 @@ void mem_init(void)
 
     mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
     mem_brk = mem_start_brk;                  /* heap is empty initially */
+    mem_peak_brk = mem_start_brk;
 }
 
 /* 
@@ -48,23 +558,26 @@ void mem_deinit(void)
 void mem_reset_brk()
 {
     mem_brk = mem_start_brk;
+    mem_peak_brk = mem_start_brk;
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area. A
+ *    negative incr shrinks the heap, but never below its first byte.
  */
 void *mem_sbrk(int incr) 
 {
     char *old_brk = mem_brk;
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+    if ( ((mem_brk + incr) < mem_start_brk) || ((mem_brk + incr) > mem_max_addr)) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
     mem_brk += incr;
+    if (mem_brk > mem_peak_brk)
+	mem_peak_brk = mem_brk;
     return (void *)old_brk;
 }
 
@@ -92,6 +605,90 @@ size_t mem_heapsize()
     return (size_t)(mem_brk - mem_start_brk);
 }
 
+/*
+ * mem_peak_heapsize() - returns the largest heap size since the last reset
+ */
+size_t mem_peak_heapsize()
+{
+    return (size_t)(mem_peak_brk - mem_start_brk);
+}
+
+/*
+ * mem_region_reserve - side regions need MEMLIB_MMAP
+ */
+void *mem_region_reserve(size_t reserve)
+{
+    return NULL;
+}
+
+/*
+ * mem_region_sbrk - side regions need MEMLIB_MMAP
+ */
+void *mem_region_sbrk(void *base, int incr)
+{
+    errno = ENOMEM;
+    return (void *)-1;
+}
+
+/*
+ * mem_map - mappings need MEMLIB_MMAP
+ */
+void *mem_map(size_t len)
+{
+    errno = ENOMEM;
+    return (void *)-1;
+}
+
+/*
+ * mem_unmap - mappings need MEMLIB_MMAP
+ */
+void mem_unmap(void *p)
+{
+}
+
+/*
+ * mem_remap - mappings need MEMLIB_MMAP
+ */
+void *mem_remap(void *p, size_t len)
+{
+    errno = ENOMEM;
+    return (void *)-1;
+}
+
+/*
+ * mem_release - no-op: the malloc'd arena is never given back to the OS
+ */
+void mem_release(void *lo, size_t len)
+{
+}
+
+/*
+ * mem_resident() - returns the heap size; every byte below brk is
+ *    assumed to be backed
+ */
+size_t mem_resident()
+{
+    return mem_heapsize();
+}
+
+/*
+ * mem_heap_limit() - returns the largest heap mem_sbrk can ever hand out
+ */
+size_t mem_heap_limit()
+{
+    return (size_t)MAX_HEAP;
+}
+
+/*
+ * mem_in_heap - returns true if [lo, hi] lies inside the heap
+ */
+int mem_in_heap(void *lo, void *hi)
+{
+    return (char *)lo >= mem_start_brk && (char *)hi < mem_brk;
+}
+
+#endif /* MEMLIB_MMAP */
+
 /*
  * mem_pagesize() - returns the page size of the system
  */
@@ -99,3 +696,17 @@ size_t mem_pagesize()
 {
     return (size_t)getpagesize();
 }
+
+/*
+ * mem_hugepagesize() - returns the size of the pages backing the heap:
+ *    HUGE_PAGE_SIZE for the mmap store under MEMLIB_HUGE, else the
+ *    system page size (the malloc'd arena is never hugepage backed)
+ */
+size_t mem_hugepagesize()
+{
+#if defined(MEMLIB_MMAP) && defined(MEMLIB_HUGE)
+    return (size_t)HUGE_PAGE_SIZE;
+#else
+    return mem_pagesize();
+#endif
+}
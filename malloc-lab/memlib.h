@@ -3,9 +3,20 @@
 void mem_init(void);               
 void mem_deinit(void);
 void *mem_sbrk(int incr);
+void *mem_region_reserve(size_t reserve);
+void *mem_region_sbrk(void *base, int incr);
+void *mem_map(size_t len);
+void mem_unmap(void *p);
+void *mem_remap(void *p, size_t len);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
+size_t mem_peak_heapsize(void);
+size_t mem_resident(void);
+void mem_release(void *lo, size_t len);
+size_t mem_heap_limit(void);
+int mem_in_heap(void *lo, void *hi);
 size_t mem_pagesize(void);
+size_t mem_hugepagesize(void);
 
@@ -1,21 +1,58 @@
 /*
- * mm.c - Segregated Free List + Binary Trace 최적화
+ * mm.c - Segregated Free List + Hot-size Quick Lists
  *
  * 구현 기술:
- * 1. Segregated Free Lists: 크기별로 분리된 free list (15개 클래스)
+ * 1. Segregated Free Lists: TLSF식 2단계 크기 클래스, 비어 있지 않은 클래스는 bitmap으로 추적
  * 2. Explicit Free Lists: free 블록만 PRED/SUCC 포인터로 연결
  * 3. Best-fit search: 각 size class에서 최적 블록 탐색
  * 4. Immediate coalescing: free 시 즉시 인접 블록과 병합
  * 5. Optimized realloc: 인접 블록 활용으로 복사 최소화
  * 6. Footer Elimination: 할당된 블록에서 footer 제거
- * 7. Size-specific Free Lists: binary trace용 특정 크기 전용 리스트
- * 8. Deferred Coalescing: 특정 크기는 병합하지 않고 정확히 재사용
+ * 7. Hot-size Quick Lists: 런타임에 자주 요청되는 크기를 찾아 크기별 LIFO 리스트로 재사용
+ * 8. Deferred Coalescing: quick list의 블록은 크기가 식을 때까지 병합하지 않음
+ * 9. Heap trimming: 큰 free 블록은 힙 끝이면 brk를 내리고, 내부면 페이지를 반환
+ * 10. Fixed-size fast path: 컴파일 타임 크기의 mm_malloc_fixed는 mm.h의 inline 코드가
+ *     크기별 bin에서 바로 꺼내고, 빈 bin을 채우거나 넘친 bin을 비울 때만 mm.c로 온다
+ *
+ * 빌드 옵션:
+ *   -DINDEX_LIST (기본) : 각 size class를 주소 순으로 정렬된 이중 연결 리스트로 관리
+ *   -DINDEX_TREE        : 각 size class를 (size, address) 키의 splay tree로 관리
+ *                          삽입/삭제/find_fit이 분할 상환 O(log n)
+ *   -DTHREAD_CACHE      : 스레드별 cache 앞단 + 하나의 lock으로 보호되는 공유 힙
+ *                          (다른 스레드의 free는 lock-free remote queue로 소유 cache에 반환)
+ *   -DSLAB_TIER         : SLAB_MAX_SIZE 이하 요청을 헤더 없는 고정 크기 slot의 run에서 처리
+ *                          (memlib side region이 필요하므로 MEMLIB_MMAP에서만 동작,
+ *                           THREAD_CACHE와 함께 쓰면 작은 요청은 thread cache가 먼저 받음)
+ *   -DLARGE_TIER        : LARGE_THRESHOLD보다 큰 요청은 각자 memlib mapping에 두고
+ *                          realloc은 mremap으로 복사 없이, free는 즉시 unmap (MEMLIB_MMAP)
+ *   -DFIT_BEST (기본)   : 기본 할당 정책 (FIT_GOOD, FIT_FIRST, FIT_NEXT도 가능).
+ *                          mm_set_policy()로 런타임에 바꿀 수 있음 (INDEX_TREE는 best만)
+ *   -DMM_STATS          : 내부 카운터와 mm_stats(), 힙 배치 snapshot mm_layout() API
+ *                          (끄면 STAT_* 매크로가 사라져 비용 없음)
+ *   -DMM_CHECK          : 힙 검사기 mm_check()와, 공유 힙 연산마다 전체 / 만진 블록만 /
+ *                          N번에 한 번 검사하는 mm_set_check() 모드
+ *   -DDEFER_COALESCE    : quick list에 못 들어간 free도 병합하지 않고 class별 unsorted
+ *                          리스트에 모았다가, 쌓이면 DEFER_BATCH개씩 또는 find_fit 실패 시 병합
+ *   -DCOMPACT_LINKS     : PRED/SUCC를 힙 시작 기준 32비트 offset으로 저장해 최소 블록 16 bytes
+ *                          (free list가 닿는 힙은 첫 region의 4 GB까지)
+ *   -DALIGN16           : payload를 8 대신 16 bytes 경계에 (블록 크기도 16의 배수, SSE/AVX용)
+ *                          더 큰 정렬은 어느 빌드든 mm_memalign()으로
+ *   -DSCAN_PREFETCH     : free list 탐색이 다음 노드를 prefetch하고, 크기를 헤더 대신 링크 옆
+ *                          사본에서 읽는다 (INDEX_LIST, 최소 블록 크기는 그대로)
+ *   -DMEMLIB_HUGE       : memlib이 힙을 2 MB hugepage로 받으므로 extend_heap도 brk를
+ *                          hugepage 경계까지 늘린다 (MEMLIB_MMAP, 작은 trace의 util은 떨어짐)
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#ifdef THREAD_CACHE
+#include <pthread.h>
+#include <stdatomic.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
@@ -32,7 +69,23 @@ team_t team = {
 #define WSIZE 4             /* 워드 및 헤더/풋터 크기 (bytes) */
 #define DSIZE 8             /* 더블 워드 크기 (bytes) */
 #define CHUNKSIZE (1 << 8)  /* 힙 확장 크기: 256 bytes */
+#ifdef ALIGN16
+#define ALIGN_SIZE 16       /* payload 정렬 = 블록 크기 단위 */
+#else
+#define ALIGN_SIZE DSIZE
+#endif
+#ifdef COMPACT_LINKS
+#define MIN_BLOCK_SIZE 16   /* 최소 free 블록 크기: 헤더 + PRED/SUCC offset + 풋터 */
+#elif defined(ALIGN16)
+#define MIN_BLOCK_SIZE 32   /* 최소 free 블록 크기 (24를 16의 배수로) */
+#else
 #define MIN_BLOCK_SIZE 24   /* 최소 free 블록 크기 */
+#endif
+
+/* Heap trimming: 이 크기 이상인 free 블록의 메모리를 OS에 돌려준다 */
+#define TRIM_THRESHOLD (1 << 17)  /* 128 KB */
+#define TRIM_KEEP (1 << 16)       /* 힙 끝 free 블록을 줄일 때 남겨두는 크기 */
+#define TRIM_STEP ((size_t)1 << 30) /* mem_sbrk의 int 인자로 한 번에 내리는 최대 크기 */
 
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
@@ -40,9 +93,20 @@ team_t team = {
 /* 크기, 할당 비트, prev_alloc 비트를 워드에 패킹 */
 #define PACK(size, alloc, prev_alloc) ((size) | (alloc) | ((prev_alloc) << 1))
 
-/* 주소 p에서 워드 읽기/쓰기 */
+/*
+ * 주소 p에서 워드 읽기/쓰기
+ * THREAD_CACHE에서는 mm_free/tcache_push/mm_usable_size가 lock 없이 헤더의 크기를
+ * 읽는 동안 lock을 쥔 place/coalesce가 같은 워드의 prev_alloc 비트를 고치므로,
+ * 헤더 워드는 relaxed atomic으로 읽고 쓴다 (x86에서는 일반 mov와 같다).
+ * 크기 비트는 블록 주인만 바꾸므로 어느 값을 읽어도 크기는 같다.
+ */
+#ifdef THREAD_CACHE
+#define GET(p) __atomic_load_n((unsigned int *)(p), __ATOMIC_RELAXED)
+#define PUT(p, val) __atomic_store_n((unsigned int *)(p), (val), __ATOMIC_RELAXED)
+#else
 #define GET(p) (*(unsigned int *)(p))
 #define PUT(p, val) (*(unsigned int *)(p) = (val))
+#endif
 
 /* 주소 p에서 크기와 할당 필드 읽기 */
 #define GET_SIZE(p) (GET(p) & ~0x7)
@@ -61,46 +125,449 @@ team_t team = {
 #define NEXT_BLKP(bp) ((char *)(bp) + GET_SIZE(HDRP(bp)))
 #define PREV_BLKP(bp) ((char *)(bp) - GET_SIZE((char *)(bp) - DSIZE))
 
+#ifdef COMPACT_LINKS
+/*
+ * Explicit free list: PRED와 SUCC를 heap_base로부터의 32비트 offset으로 저장
+ * bp는 항상 heap_base보다 뒤에 있으므로 offset 0은 NULL로 쓴다.
+ */
+#define LINK_ENC(ptr) ((ptr) ? (unsigned int)((char *)(ptr) - heap_base) : 0u)
+#define LINK_DEC(off) ((off) ? (void *)(heap_base + (off)) : NULL)
+#define GET_PRED(bp) LINK_DEC(GET(bp))
+#define GET_SUCC(bp) LINK_DEC(GET((char *)(bp) + WSIZE))
+#define SET_PRED(bp, ptr) PUT(bp, LINK_ENC(ptr))
+#define SET_SUCC(bp, ptr) PUT((char *)(bp) + WSIZE, LINK_ENC(ptr))
+#else
 /* Explicit free list: PRED와 SUCC 포인터 */
 #define GET_PRED(bp) (*(void **)(bp))
 #define GET_SUCC(bp) (*(void **)((char *)(bp) + DSIZE))
 #define SET_PRED(bp, ptr) (GET_PRED(bp) = (ptr))
 #define SET_SUCC(bp, ptr) (GET_SUCC(bp) = (ptr))
+#endif
+
+/*
+ * SCAN_PREFETCH: free list에 든 블록은 링크 바로 뒤(FSIZE_OFF)에 헤더 값을 한 번 더 적어 두고,
+ * 리스트 탐색은 헤더 대신 그 값을 읽어 SUCC와 같은 cache line에서 크기를 얻는다.
+ * 최소 블록에서는 그 자리가 풋터(같은 값)라 공간이 더 들지 않는다.
+ * FREE_META는 free 블록 payload 앞쪽의 메타데이터 크기 (페이지 반환에서 제외)
+ */
+#ifdef COMPACT_LINKS
+#define FSIZE_OFF DSIZE
+#else
+#define FSIZE_OFF (2 * DSIZE)
+#endif
+#ifdef SCAN_PREFETCH
+#define GET_FSIZE(bp) GET_SIZE((char *)(bp) + FSIZE_OFF)
+#define SET_FSIZE(bp) PUT((char *)(bp) + FSIZE_OFF, GET(HDRP(bp)))
+#define PREFETCH(p) __builtin_prefetch(p)
+#define FREE_META (FSIZE_OFF + DSIZE)
+#else
+#define GET_FSIZE(bp) GET_SIZE(HDRP(bp))
+#define SET_FSIZE(bp)
+#define PREFETCH(p)
+#define FREE_META (2 * DSIZE)
+#endif
+
+/*
+ * INDEX_TREE 모드: 같은 두 슬롯을 splay tree의 왼쪽/오른쪽 자식으로 사용
+ * (트리 노드에 추가 공간이 필요 없으므로 MIN_BLOCK_SIZE는 그대로)
+ */
+#define GET_LEFT(bp) GET_PRED(bp)
+#define GET_RIGHT(bp) GET_SUCC(bp)
+#define SET_LEFT(bp, ptr) SET_PRED(bp, ptr)
+#define SET_RIGHT(bp, ptr) SET_SUCC(bp, ptr)
+
+/*
+ * Segregated list 크기 클래스: TLSF식 2단계
+ * 1단계(FL)는 2의 거듭제곱 구간, 2단계(SL)는 그 구간을 SL_COUNT개로 등분.
+ * 1 << FL_SHIFT 미만은 FL 0에서 DSIZE 간격. 블록 크기는 32비트 헤더에 들어가므로 FL은 28개.
+ */
+#define SL_LOG2 2
+#define SL_COUNT (1 << SL_LOG2)
+#define FL_SHIFT (SL_LOG2 + 3)
+#define FL_COUNT (32 - FL_SHIFT + 1)
+#define SEG_LIST_COUNT (FL_COUNT * SL_COUNT)
+
+/*
+ * 할당 정책: class 하나 안에서의 탐색, free 블록 삽입 순서, place의 분할 방향
+ * find_fit은 자기 class에서 못 찾으면 다음 비어 있지 않은 class로 넘어간다.
+ */
+typedef struct {
+    const char *name;
+    void *(*fit)(int index, size_t asize);  /* class index에서 asize 이상 블록, 없으면 NULL */
+    void (*insert)(int index, void *bp);    /* class index에 free 블록 추가 */
+    size_t split_high;                      /* asize가 이 이상이면 블록 끝에서 떼어 할당 */
+} policy_t;
 
-/* Segregated list 크기 클래스 */
-#define SEG_LIST_COUNT 15
+#define SPLIT_HIGH 112          /* 큰 요청은 끝에서 할당해 작은 블록을 앞쪽에 모은다 */
+#define SPLIT_NEVER ((size_t)-1)
+#define GOOD_FIT_SCAN 4         /* good fit: 맞는 블록을 이만큼 본 뒤 그중 최선 */
 
-/* Binary trace 최적화: 특정 크기 전용 리스트 */
-#define EXACT_FIT_CLASSES 3
-#define SIZE_80  80   /* 64B + 16B header/footer */
-#define SIZE_128 128  /* 112B + 16B header/footer */
-#define SIZE_464 464  /* 448B + 16B header/footer */
+/*
+ * Hot-size cache: 자주 요청되는 asize 상위 HOT_SLOTS개를 count-min sketch로 찾아
+ * 크기별 LIFO quick list를 둔다. quick list의 블록은 힙 입장에서는 할당된 블록이라
+ * coalescing 없이 그대로 재사용되고, 크기가 식으면 heap_free로 한꺼번에 돌려준다.
+ */
+#define HOT_SLOTS 4             /* 동시에 hot으로 다루는 크기 수 */
+#define HOT_LIST_MAX 128        /* quick list당 최대 블록 수 */
+#define SKETCH_DEPTH 2
+#define SKETCH_WIDTH 256
+#define HOT_WINDOW 1024         /* 이만큼 할당할 때마다 모든 카운터를 절반으로 */
+#define HOT_MIN_COUNT 32        /* sketch 추정치가 이 이상이면 hot 후보 */
+#define HOT_COLD_COUNT 8        /* 감쇠 후 이 미만이면 cold: quick list를 비움 */
+
+/* quick list 연결 포인터 (할당된 블록의 payload 첫 8바이트) */
+#define QL_NEXT(bp) (*(void **)(bp))
+
+#ifdef DEFER_COALESCE
+/*
+ * Deferred coalescing: free된 블록을 할당 표시 그대로 class별 unsorted 리스트
+ * (QL_NEXT로 연결)에 넣는다. 같은 class의 요청이 오면 분할 없이 재사용하고,
+ * DEFER_MAX개를 넘으면 DEFER_BATCH개만 실제로 병합해 free 경로의 일을 제한한다.
+ */
+#define DEFER_MAX 64           /* unsorted 리스트 전체의 최대 블록 수 */
+#define DEFER_BATCH 16          /* 한 번에 병합하는 블록 수 */
+#define DEFER_SCAN 4            /* 할당 시 unsorted 리스트에서 볼 블록 수 */
+#endif
 
 /* 전역 변수 */
 static char *heap_listp = NULL;
-static void *seg_list[SEG_LIST_COUNT];
-static void *exact_fit_lists[EXACT_FIT_CLASSES];  /* 80B, 128B, 464B 전용 */
+#ifdef COMPACT_LINKS
+static char *heap_base;     /* free list offset의 기준 (mem_heap_lo) */
+#endif
 
-/* Binary pattern 감지 */
-static int binary_mode = 0;
-static int alloc_count = 0;
-static int exact_fit_count[EXACT_FIT_CLASSES] = {0, 0, 0};
+/*
+ * 힙 region: memlib이 이전 brk와 인접하지 않은 주소를 돌려주면 (MEMLIB_MMAP)
+ * 거기서부터 프롤로그를 다시 세운다. 각 region의 첫 블록 포인터를 기록해
+ * 힙 전체를 순회할 때 사용한다.
+ */
+#define MAX_HEAP_REGIONS 64
+static char *heap_regions[MAX_HEAP_REGIONS];
+static int num_heap_regions = 0;
+static void *seg_list[SEG_LIST_COUNT];
+static unsigned int fl_bitmap;              /* bit f: FL f에 비어 있지 않은 클래스가 있음 */
+static unsigned int sl_bitmap[FL_COUNT];    /* bit s: 클래스 (f, s)가 비어 있지 않음 */
+
+/* Hot-size cache 상태 */
+static unsigned short sketch[SKETCH_DEPTH][SKETCH_WIDTH];
+static size_t hot_size[HOT_SLOTS];          /* 0이면 빈 slot */
+static unsigned int hot_count[HOT_SLOTS];   /* 감쇠되는 요청 횟수 */
+static void *hot_list[HOT_SLOTS];           /* LIFO quick list */
+static int hot_len[HOT_SLOTS];
+static unsigned int hot_clock = 0;          /* 마지막 감쇠 이후 할당 수 */
+
+#if MM_MIN_BLOCK != MIN_BLOCK_SIZE || MM_ALIGN != ALIGN_SIZE
+#error "MM_MIN_BLOCK and MM_ALIGN in mm.h must match MIN_BLOCK_SIZE and ALIGN_SIZE"
+#endif
+
+#ifndef THREAD_CACHE
+/*
+ * 고정 크기 fast path (mm.h의 mm_malloc_fixed): 블록 크기 / DSIZE별 LIFO bin.
+ * 꺼내고 넣는 일은 mm.h의 inline 함수가 하고, mm.c는 bin이 비거나 넘칠 때만
+ * MM_FIXED_BATCH개씩 힙과 주고받는다. bin의 블록은 힙 입장에서는 할당된 블록이라
+ * find_fit에 보이지 않으므로, 합계를 MM_FIXED_CAP 바이트로 묶고 힙을 늘리기 전에
+ * hot_consolidate가 모두 free index로 돌려보낸다.
+ */
+void *mm_fixed_bin[MM_FIXED_BINS];
+unsigned int mm_fixed_len[MM_FIXED_BINS];
+size_t mm_fixed_bytes;
+#endif
+
+#ifdef DEFER_COALESCE
+static void *defer_list[SEG_LIST_COUNT];    /* class별 병합 대기 블록 */
+static int defer_count = 0;
+static int defer_cursor = 0;                /* 다음 병합 batch를 시작할 class */
+#endif
+
+#ifdef THREAD_CACHE
+/*
+ * Thread cache: TCACHE_MAX_SIZE 이하 블록은 스레드별 bin(블록 크기별 LIFO, mm_free_sized는 요청 크기의 bin)에서
+ * 처리하고, 공유 힙과는 TCACHE_BATCH개 단위로 lock 한 번에 주고받는다.
+ * bin에 있는 블록은 공유 힙 입장에서는 여전히 할당된 블록이다.
+ */
+#define TCACHE_MAX_SIZE 512                         /* thread cache 대상 최대 블록 크기 */
+#define TCACHE_BINS (TCACHE_MAX_SIZE / DSIZE + 1)   /* 블록 크기 / DSIZE로 인덱싱 */
+#define TCACHE_BIN_MAX 64                           /* bin당 최대 보관 블록 수 */
+#define TCACHE_BATCH 16                             /* refill/drain 단위 */
+#define TCACHE_MAX_THREADS 64                       /* 동시에 cache를 가질 수 있는 스레드 수 */
+
+/* 블록 소유자 힌트: 페이지 해시 -> cache id (0은 소유자 없음) */
+#define OWNER_SLOTS (1 << 16)
+#define OWNER_SLOT(bp) (((uintptr_t)(bp) >> 12) & (OWNER_SLOTS - 1))
+
+/* bin과 remote queue의 연결 포인터 (할당된 블록의 payload 첫 8바이트) */
+#define TC_NEXT(bp) (*(void **)(bp))
+
+typedef struct {
+    void *bins[TCACHE_BINS];
+    int counts[TCACHE_BINS];
+    _Atomic(void *) remote;     /* 다른 스레드가 free한 블록 (Treiber stack) */
+    atomic_int live;            /* 이 slot을 사용하는 스레드가 살아 있는지 */
+    int id;
+} __attribute__((aligned(64))) tcache_t;
+
+static tcache_t tcaches[TCACHE_MAX_THREADS + 1];   /* 0번 slot은 사용하지 않음 */
+static _Atomic unsigned char page_owner[OWNER_SLOTS];
+static __thread tcache_t *my_tcache = NULL;
+static pthread_key_t tcache_key;
+static pthread_once_t tcache_key_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define HEAP_LOCK() pthread_mutex_lock(&heap_lock)
+#define HEAP_UNLOCK() pthread_mutex_unlock(&heap_lock)
+#else
+#define HEAP_LOCK() ((void)0)
+#define HEAP_UNLOCK() ((void)0)
+#endif
+
+#ifdef MM_STATS
+/*
+ * 내부 통계: 공유 힙 경로의 카운터 (HEAP_LOCK 안에서만 갱신)
+ * walk는 진행 중인 탐색이 지나간 블록 수: STAT_WALK_BEGIN으로 0에서 시작해서
+ * STAT_STEP으로 세고, STAT_WALK_END가 해당 히스토그램에 넣는다
+ */
+#if SEG_LIST_COUNT != MM_STATS_CLASSES
+#error "MM_STATS_CLASSES in mm.h must match SEG_LIST_COUNT"
+#endif
+static mm_stats_t stats;
+static unsigned long walk;
+
+#define STAT_ADD(field, n) (stats.field += (n))
+#define STAT_WALK_BEGIN() (walk = 0)
+#define STAT_STEP() (walk++)
+#define STAT_WALK_END(name) stat_walk(stats.name##_walk_hist, &stats.name##_walk_total)
+#else
+#define STAT_ADD(field, n) ((void)0)
+#define STAT_WALK_BEGIN() ((void)0)
+#define STAT_STEP() ((void)0)
+#define STAT_WALK_END(name) ((void)0)
+#endif
+#define STAT_INC(field) STAT_ADD(field, 1)
+
+#ifdef MM_CHECK
+/*
+ * 힙 검사: 공유 힙 연산은 HEAP_DONE으로 끝나고, 거기서 check_mode에 따라
+ * 힙 전체 (FULL, SAMPLE이면 check_every번째 연산마다) 또는 이번 연산이 만진
+ * 블록만 (INCR) 검사한다. 만진 블록은 CHECK_TOUCH로 check_ring에 모으고,
+ * free list에서 빠지거나 병합될 블록은 CHECK_UNTOUCH로 지운다 (넘치면 전체 검사).
+ */
+#define CHECK_RING 32           /* 연산 하나에서 기록하는 블록 수 */
+#define CHECK_REPORT 20         /* 검사 한 번에 출력하는 문제 수 */
+
+static int check_mode = MM_CHECK_OFF;
+static unsigned long check_every = 1;
+static unsigned long check_ops = 0;         /* mm_init 이후 공유 힙 연산 수 */
+static void *check_ring[CHECK_RING];
+static int check_touched = 0;               /* CHECK_RING보다 크면 넘침 */
+static int check_problems;                  /* 진행 중인 검사에서 찾은 문제 수 */
+
+#define CHECK_TOUCH(bp) \
+    (check_touched < CHECK_RING ? (void)(check_ring[check_touched++] = (bp)) \
+                                : (void)(check_touched = CHECK_RING + 1))
+#define CHECK_UNTOUCH(bp) check_untouch(bp)
+#define HEAP_DONE() do { check_op(); HEAP_UNLOCK(); } while (0)
+#else
+#define CHECK_TOUCH(bp) ((void)0)
+#define CHECK_UNTOUCH(bp) ((void)0)
+#define HEAP_DONE() HEAP_UNLOCK()
+#endif
+
+#ifdef SLAB_TIER
+/*
+ * Slab tier: SLAB_MAX_SIZE 이하 요청은 side region에서 잘라낸 RUN_SIZE 크기 run의
+ * 고정 크기 slot으로 처리한다. slot에는 헤더가 없고, run 헤더는 주소를 RUN_SIZE로
+ * 마스킹해서 찾는다. slab 주소인지는 side region 범위 비교 한 번으로 판단.
+ */
+#define SLAB_MAX_SIZE 256                       /* slab 대상 최대 payload */
+#define SLAB_CLASSES (SLAB_MAX_SIZE / ALIGN_SIZE)   /* slot 크기 8, 16, ..., 256 (ALIGN16: 16, 32, ...) */
+#define SLAB_CLASS(size) (((size) + ALIGN_SIZE - 1) / ALIGN_SIZE - 1)
+#define SLAB_RESERVE ((size_t)1 << 32)          /* slab side region 예약 크기 */
+#define RUN_SIZE 4096
+#define SLAB_BITMAP_WORDS 8                     /* run당 최대 512 slot */
+
+typedef struct slab_run {
+    struct slab_run *next;      /* 같은 class의 partial run 리스트 또는 빈 run 리스트 */
+    struct slab_run *prev;
+    unsigned int slot_size;
+    unsigned int recip;         /* ceil(2^32 / slot_size): offset / slot_size를 곱셈으로 */
+    unsigned short nslots;
+    unsigned short nfree;
+    unsigned short cls;
+    uint64_t bitmap[SLAB_BITMAP_WORDS];  /* 1 = 빈 slot */
+} slab_run_t;
+
+#define SLAB_HDR_SIZE ((sizeof(slab_run_t) + ALIGN_SIZE - 1) & ~(size_t)(ALIGN_SIZE - 1))
+#define RUN_OF(p) ((slab_run_t *)((uintptr_t)(p) & ~(uintptr_t)(RUN_SIZE - 1)))
+#define IS_SLAB(p) ((uintptr_t)((char *)(p) - slab_base) < slab_used)
+
+static char *slab_base = NULL;      /* slab side region 시작 (MEMLIB_ARENA면 NULL) */
+static size_t slab_used = 0;        /* run으로 잘라낸 바이트 수 */
+static slab_run_t *slab_partial[SLAB_CLASSES];  /* 빈 slot이 있는 run */
+static slab_run_t *slab_empty = NULL;           /* 아무 class도 쓰지 않는 run */
+#endif
+
+#ifdef LARGE_TIER
+/*
+ * Large tier: LARGE_THRESHOLD보다 큰 요청은 memlib mapping 하나에 단독으로 둔다.
+ * mapping 앞 LARGE_HDR_SIZE 바이트에 mapping 길이를 두고, payload 바로 앞 헤더
+ * 워드에는 LARGE_BIT를 세워 일반 힙 블록과 구분한다 (힙 블록 크기는 8의 배수라
+ * 헤더의 bit 2는 항상 0).
+ */
+#ifndef LARGE_THRESHOLD
+#define LARGE_THRESHOLD (1 << 16)   /* 64 KB */
+#endif
+#define LARGE_HDR_SIZE (2 * DSIZE)
+#define LARGE_BIT 0x4
+#define IS_LARGE(bp) (GET(HDRP(bp)) & LARGE_BIT)
+#define LARGE_LEN(bp) (*(size_t *)((char *)(bp) - LARGE_HDR_SIZE))
+#define LARGE_MAP_LEN(size) \
+    (((size) + LARGE_HDR_SIZE + mem_pagesize() - 1) & ~(mem_pagesize() - 1))
+#endif
 
 /* 함수 프로토타입 */
+static inline size_t adjust_size(size_t size);
+static void *heap_alloc(size_t asize);
+static void heap_free(void *bp);
+static void defer_free(void *bp);
+static void free_block(void *bp);
+static void *heap_realloc(void *ptr, size_t size);
+static int heap_expand(void *ptr, size_t asize);
+static void *heap_expand_back(void *ptr, size_t asize);
+static void heap_shrink(void *ptr, size_t asize);
 static void *extend_heap(size_t words);
 static void *coalesce(void *bp);
+static void release_free_block(void *bp, char *lo, char *hi);
 static void *find_fit(size_t asize);
 static void *place(void *bp, size_t asize);
-static int get_seg_index(size_t size);
+static void *place_aligned(void *bp, size_t asize, size_t align);
+static inline int get_seg_index(size_t size);
+static inline int next_class(int index);
+static inline void mark_class(int index);
+static inline void unmark_class(int index);
 static void add_to_free_list(void *bp);
 static void remove_from_free_list(void *bp);
-
-/* Binary trace 최적화 헬퍼 함수 */
-static int get_exact_fit_index(size_t size);
-static void add_to_exact_list(void *bp, int index);
-static void *get_from_exact_list(size_t asize);
-static void remove_from_exact_list(void *bp, int index);
-static void detect_binary_pattern(size_t asize);
+#ifdef INDEX_TREE
+static int tree_cmp(size_t size, void *addr, void *node);
+static void *tree_splay(void *root, size_t size, void *addr);
+static void *tree_lower_bound(int index, size_t asize);
+static void tree_insert(int index, void *bp);
+#else
+static void *fit_best(int index, size_t asize);
+static void *fit_good(int index, size_t asize);
+static void *fit_first(int index, size_t asize);
+static void *fit_next(int index, size_t asize);
+static void insert_addr(int index, void *bp);
+static void insert_lifo(int index, void *bp);
+#endif
+
+#ifdef THREAD_CACHE
+static tcache_t *tcache_get(void);
+static void tcache_make_key(void);
+static void tcache_detach(void *arg);
+static void tcache_reset_all(void);
+static void *tcache_malloc(size_t asize);
+static void tcache_free(void *bp, size_t asize);
+static void tcache_push(tcache_t *tc, void *bp, size_t asize);
+static void tcache_collect_remote(tcache_t *tc);
+#endif
+
+#ifdef SLAB_TIER
+static void slab_init(void);
+static void *slab_alloc(size_t size);
+static void slab_free(void *p);
+static void *slab_realloc(void *p, size_t size);
+static slab_run_t *slab_new_run(int cls);
+static void slab_unlink(slab_run_t *run);
+#endif
+
+#ifdef LARGE_TIER
+static void *large_alloc(size_t size);
+static void large_free(void *bp);
+static void *large_realloc(void *bp, size_t size);
+static void *large_from_heap(void *ptr, size_t size);
+#endif
+
+/* Hot-size cache 헬퍼 함수 */
+static int hot_slot(size_t asize);
+static int hot_record(size_t asize);
+static unsigned int sketch_add(size_t asize);
+static void hot_decay(void);
+static void hot_flush(int slot);
+static int hot_consolidate(void);
+static int hot_push(size_t asize, void *bp);
+
+#ifdef DEFER_COALESCE
+static void *defer_take(size_t asize);
+static int defer_drain(int budget);
+#endif
+
+static void carve_batch(void *bp, size_t asize, size_t n, void **ptrs);
+static int ptr_cmp(const void *a, const void *b);
+
+#ifndef THREAD_CACHE
+static void fixed_release(int bin, int n);
+static int fixed_flush(void);
+#endif
+
+#ifdef MM_STATS
+static void stat_walk(unsigned long *hist, unsigned long *total);
+#endif
+
+#ifdef MM_CHECK
+static void check_op(void);
+static void check_untouch(void *bp);
+static int check_heap(void);
+static int check_block(void *bp);
+static void check_index(void *bp, int index);
+static int check_node(void *p, int index);
+#ifdef INDEX_TREE
+static size_t check_tree(void *node, int index, void *lo, void *hi, size_t limit);
+#endif
+static void check_report(void *bp, const char *what);
+#endif
+
+/* 내장 정책 (이름은 mm_set_policy / mdriver -P에 쓰인다) */
+static const policy_t policies[] = {
+#ifdef INDEX_TREE
+    {"best", tree_lower_bound, tree_insert, SPLIT_HIGH},
+#else
+    {"best", fit_best, insert_addr, SPLIT_HIGH},
+    {"good", fit_good, insert_addr, SPLIT_HIGH},
+    {"first", fit_first, insert_addr, SPLIT_NEVER},
+    {"next", fit_next, insert_addr, SPLIT_NEVER},
+    {"best-lifo", fit_best, insert_lifo, SPLIT_HIGH},
+    {"first-lifo", fit_first, insert_lifo, SPLIT_NEVER},
+#endif
+};
+#define NUM_POLICIES ((int)(sizeof(policies) / sizeof(policies[0])))
+
+#if defined(INDEX_TREE) || defined(FIT_BEST)
+#define DEFAULT_POLICY 0
+#elif defined(FIT_GOOD)
+#define DEFAULT_POLICY 1
+#elif defined(FIT_FIRST)
+#define DEFAULT_POLICY 2
+#elif defined(FIT_NEXT)
+#define DEFAULT_POLICY 3
+#else
+#define DEFAULT_POLICY 0
+#endif
+
+static const policy_t *policy = &policies[DEFAULT_POLICY];
+
+/* 런타임 튜닝 파라미터 (mm_set_params), 기본값은 위의 상수 */
+static mm_params_t params = {
+    CHUNKSIZE,          /* chunk_size */
+    MIN_BLOCK_SIZE,     /* split_min */
+    0,                  /* split_high: 0이면 정책의 값 */
+    HOT_MIN_COUNT,      /* hot_min_count */
+    HOT_COLD_COUNT,     /* hot_cold_count */
+    HOT_WINDOW,         /* hot_window */
+    HOT_LIST_MAX,       /* hot_list_max */
+    TRIM_THRESHOLD      /* trim_threshold */
+};
+#ifndef INDEX_TREE
+static void *rover[SEG_LIST_COUNT];        /* next fit: class별 다음 탐색 시작 블록 */
+#endif
 
 /*
  * mm_init - malloc 패키지 초기화
@@ -111,27 +578,71 @@ int mm_init(void)
     for (int i = 0; i < SEG_LIST_COUNT; i++) {
         seg_list[i] = NULL;
     }
-
-    /* Binary trace 전용 리스트 초기화 */
-    for (int i = 0; i < EXACT_FIT_CLASSES; i++) {
-        exact_fit_lists[i] = NULL;
-        exact_fit_count[i] = 0;
+    fl_bitmap = 0;
+    memset(sl_bitmap, 0, sizeof(sl_bitmap));
+#ifndef INDEX_TREE
+    memset(rover, 0, sizeof(rover));
+#endif
+
+    /* Hot-size cache 초기화 (이전 힙의 quick list는 버린다) */
+    memset(sketch, 0, sizeof(sketch));
+    for (int i = 0; i < HOT_SLOTS; i++) {
+        hot_size[i] = 0;
+        hot_count[i] = 0;
+        hot_list[i] = NULL;
+        hot_len[i] = 0;
     }
-    binary_mode = 0;
-    alloc_count = 0;
+    hot_clock = 0;
+
+#ifndef THREAD_CACHE
+    /* 고정 크기 bin도 이전 힙의 블록이므로 버린다 */
+    memset(mm_fixed_bin, 0, sizeof(mm_fixed_bin));
+    memset(mm_fixed_len, 0, sizeof(mm_fixed_len));
+    mm_fixed_bytes = 0;
+#endif
+
+#ifdef DEFER_COALESCE
+    memset(defer_list, 0, sizeof(defer_list));
+    defer_count = 0;
+    defer_cursor = 0;
+#endif
+
+#ifdef MM_STATS
+    memset(&stats, 0, sizeof(stats));
+    walk = 0;
+#endif
+
+#ifdef MM_CHECK
+    check_ops = 0;
+    check_touched = 0;
+#endif
+
+#ifdef THREAD_CACHE
+    /* 이전 힙을 가리키는 thread cache 내용 폐기 (mm_init은 단일 스레드에서 호출) */
+    tcache_reset_all();
+#endif
+
+#ifdef SLAB_TIER
+    slab_init();
+#endif
 
     /* 초기 빈 힙 생성 */
     if ((heap_listp = mem_sbrk(4 * WSIZE)) == (void *)-1)
         return -1;
+#ifdef COMPACT_LINKS
+    heap_base = mem_heap_lo();
+#endif
 
     PUT(heap_listp, 0);                                /* 정렬 패딩 */
     PUT(heap_listp + (1 * WSIZE), PACK(DSIZE, 1, 1));  /* 프롤로그 헤더 */
     PUT(heap_listp + (2 * WSIZE), PACK(DSIZE, 1, 1));  /* 프롤로그 풋터 */
     PUT(heap_listp + (3 * WSIZE), PACK(0, 1, 1));      /* 에필로그 헤더 */
     heap_listp += (2 * WSIZE);
+    heap_regions[0] = heap_listp + DSIZE;
+    num_heap_regions = 1;
 
-    /* 빈 힙을 CHUNKSIZE 바이트로 확장 */
-    if (extend_heap(CHUNKSIZE / WSIZE) == NULL)
+    /* 빈 힙을 chunk_size 바이트로 확장 */
+    if (extend_heap(params.chunk_size / WSIZE) == NULL)
         return -1;
 
     return 0;
@@ -143,33 +654,40 @@ int mm_init(void)
 void *mm_malloc(size_t size)
 {
     size_t asize;
-    size_t extendsize;
     void *bp;
 
-    if (size == 0)
+    /* extend_heap이 받을 수 없는 크기 (adjust_size도 넘치지 않게 먼저 거른다) */
+    if (size == 0 || size > INT_MAX - 2 * DSIZE)
         return NULL;
 
-    /* 블록 크기 조정 (오버헤드 및 정렬 요구사항 포함) */
-    if (size <= DSIZE)
-        asize = 2 * DSIZE;
-    else
-        asize = DSIZE * ((size + (DSIZE) + (DSIZE - 1)) / DSIZE);
-
-    /* Binary pattern 감지 */
-    detect_binary_pattern(asize);
+    asize = adjust_size(size);
 
-    /* Free list에서 fit 검색 */
-    bp = find_fit(asize);
+#ifdef THREAD_CACHE
+    /* 작은 요청은 스레드 로컬 bin에서 처리 */
+    if (asize <= TCACHE_MAX_SIZE)
+        return tcache_malloc(asize);
+#endif
 
-    if (bp != NULL) {
-        return place(bp, asize);
+    HEAP_LOCK();
+#ifdef SLAB_TIER
+    /* 작은 요청은 slab run에서 (side region이 가득 차면 일반 힙으로) */
+    if (size <= SLAB_MAX_SIZE && (bp = slab_alloc(size)) != NULL) {
+        STAT_INC(slab_allocs);
+        HEAP_DONE();
+        return bp;
     }
-
-    /* Fit을 찾지 못함. 메모리 확장 후 블록 배치 */
-    extendsize = MAX(asize, CHUNKSIZE);
-    if ((bp = extend_heap(extendsize / WSIZE)) == NULL)
-        return NULL;
-    return place(bp, asize);
+#endif
+#ifdef LARGE_TIER
+    /* 큰 요청은 전용 mapping에 (mapping을 만들 수 없으면 일반 힙으로) */
+    if (size > LARGE_THRESHOLD && (bp = large_alloc(size)) != NULL) {
+        STAT_INC(large_allocs);
+        HEAP_DONE();
+        return bp;
+    }
+#endif
+    bp = heap_alloc(asize);
+    HEAP_DONE();
+    return bp;
 }
 
 /*
@@ -180,14 +698,35 @@ void mm_free(void *bp)
     if (bp == NULL)
         return;
 
-    size_t size = GET_SIZE(HDRP(bp));
-    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+#ifdef SLAB_TIER
+    /* slab slot에는 헤더가 없으므로 헤더를 읽기 전에 판별 */
+    if (IS_SLAB(bp)) {
+        HEAP_LOCK();
+        slab_free(bp);
+        HEAP_DONE();
+        return;
+    }
+#endif
 
-    PUT(HDRP(bp), PACK(size, 0, prev_alloc));
-    PUT(FTRP(bp), PACK(size, 0, prev_alloc));
+#ifdef LARGE_TIER
+    if (IS_LARGE(bp)) {
+        HEAP_LOCK();
+        large_free(bp);
+        HEAP_DONE();
+        return;
+    }
+#endif
 
-    /* 일반 coalescing */
-    coalesce(bp);
+#ifdef THREAD_CACHE
+    if (GET_SIZE(HDRP(bp)) <= TCACHE_MAX_SIZE) {
+        tcache_free(bp, GET_SIZE(HDRP(bp)));
+        return;
+    }
+#endif
+
+    HEAP_LOCK();
+    heap_free(bp);
+    HEAP_DONE();
 }
 
 /*
@@ -196,8 +735,6 @@ void mm_free(void *bp)
 void *mm_realloc(void *ptr, size_t size)
 {
     void *newptr;
-    size_t oldsize, asize, next_size;
-    size_t combined_size;
 
     if (ptr == NULL)
         return mm_malloc(size);
@@ -207,403 +744,2502 @@ void *mm_realloc(void *ptr, size_t size)
         return NULL;
     }
 
-    oldsize = GET_SIZE(HDRP(ptr));
-
-    if (size <= DSIZE)
-        asize = 2 * DSIZE;
-    else
-        asize = DSIZE * ((size + (DSIZE) + (DSIZE - 1)) / DSIZE);
-
-    if (asize <= oldsize) {
-        return ptr;
-    }
-
-    /* 다음 블록이 free면 확장 시도 */
-    void *next_bp = NEXT_BLKP(ptr);
-    next_size = GET_SIZE(HDRP(next_bp));
-    int next_alloc = GET_ALLOC(HDRP(next_bp));
-
-    if (!next_alloc && (oldsize + next_size) >= asize) {
-        remove_from_free_list(next_bp);
-        combined_size = oldsize + next_size;
-        size_t prev_alloc = GET_PREV_ALLOC(HDRP(ptr));
-        PUT(HDRP(ptr), PACK(combined_size, 1, prev_alloc));
-        SET_PREV_ALLOC(HDRP(NEXT_BLKP(ptr)));
-        return ptr;
-    }
-
-    /* 새 블록 할당 */
-    newptr = mm_malloc(size);
-    if (newptr == NULL)
+    /* 너무 크면 실패하고 블록은 그대로 */
+    if (size > INT_MAX - 2 * DSIZE)
         return NULL;
 
-    memcpy(newptr, ptr, oldsize - WSIZE);
-    mm_free(ptr);
+#ifdef SLAB_TIER
+    if (IS_SLAB(ptr))
+        return slab_realloc(ptr, size);
+#endif
+
+#ifdef LARGE_TIER
+    if (IS_LARGE(ptr))
+        return large_realloc(ptr, size);
+    if (size > LARGE_THRESHOLD && (newptr = large_from_heap(ptr, size)) != NULL)
+        return newptr;
+#endif
+
+    HEAP_LOCK();
+    newptr = heap_realloc(ptr, size);
+    HEAP_DONE();
     return newptr;
 }
 
 /*
- * extend_heap - free 블록으로 힙 확장
+ * mm_memalign - payload가 align(2의 거듭제곱) 바이트 경계에 오는 size 바이트 블록 할당
+ * 정렬 위치가 반드시 들어가는 free 블록을 찾아 place_aligned로 잘라내고 앞뒤 조각은
+ * free list에 돌려주므로, 과할당해서 안에서 정렬하는 것과 달리 블록에 낭비가 남지 않는다.
+ * 결과는 보통 힙 블록이라 mm_free/mm_realloc을 그대로 쓴다 (realloc은 정렬을 유지하지 않음)
  */
-static void *extend_heap(size_t words)
+void *mm_memalign(size_t align, size_t size)
 {
-    char *bp;
-    size_t size;
-    size_t prev_alloc;
+    size_t asize, need;
+    void *bp;
 
-    size = (words % 2) ? (words + 1) * WSIZE : words * WSIZE;
-    if ((long)(bp = mem_sbrk(size)) == -1)
+    if (size == 0 || align == 0 || (align & (align - 1)) != 0)
+        return NULL;
+    if (align <= ALIGN_SIZE)
+        return mm_malloc(size);
+    if (size > INT_MAX - 2 * DSIZE)
         return NULL;
 
-    prev_alloc = GET_PREV_ALLOC(HDRP(bp));
-
-    PUT(HDRP(bp), PACK(size, 0, prev_alloc));
-    PUT(FTRP(bp), PACK(size, 0, prev_alloc));
-    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1, 0));
+    asize = adjust_size(size);
+    if (asize > INT_MAX - 2 * DSIZE - align - MIN_BLOCK_SIZE)
+        return NULL;
+    need = asize + align + MIN_BLOCK_SIZE;  /* 앞 조각이 가장 길 때 */
 
-    return coalesce(bp);
+    HEAP_LOCK();
+    bp = find_fit(need);
+    if (bp == NULL && hot_consolidate())
+        bp = find_fit(need);
+    if (bp == NULL)
+        bp = extend_heap(MAX(need, params.chunk_size) / WSIZE);
+    if (bp != NULL)
+        bp = place_aligned(bp, asize, align);
+    HEAP_DONE();
+    return bp;
 }
 
 /*
- * coalesce - 인접한 free 블록들과 병합
- * Binary mode에서는 특정 크기 블록의 coalescing을 지연
+ * mm_free_sized - 호출자가 아는 크기(mm_malloc/mm_realloc/mm_try_expand에 준 size)로 블록 해제
+ * tier, tcache bin, hot quick list를 모두 size로 고르고, 헤더는 블록을 실제로
+ * free 블록으로 되돌리는 defer_free에서만 읽는다. 블록은 항상 asize 이상이므로
+ * asize의 bin/list에 넣어도 그 크기 요청을 채울 수 있다
  */
-static void *coalesce(void *bp)
+void mm_free_sized(void *bp, size_t size)
 {
-    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
-    void *next_bp = NEXT_BLKP(bp);
-    size_t next_alloc = GET_ALLOC(HDRP(next_bp));
-    size_t size = GET_SIZE(HDRP(bp));
+    size_t asize;
 
-    /* Binary mode에서 exact fit 크기는 coalesce하지 않음 */
-    if (binary_mode && get_exact_fit_index(size) >= 0) {
-        add_to_free_list(bp);
-        CLEAR_PREV_ALLOC(HDRP(next_bp));
-        return bp;
-    }
+    if (bp == NULL)
+        return;
+    asize = adjust_size(size);
 
-    if (prev_alloc && next_alloc) {
-        add_to_free_list(bp);
-        CLEAR_PREV_ALLOC(HDRP(next_bp));
-        return bp;
-    }
-    else if (prev_alloc && !next_alloc) {
-        remove_from_free_list(next_bp);
-        size += GET_SIZE(HDRP(next_bp));
-        PUT(HDRP(bp), PACK(size, 0, 1));
-        PUT(FTRP(bp), PACK(size, 0, 1));
-        add_to_free_list(bp);
-        CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+#ifdef SLAB_TIER
+    if (IS_SLAB(bp)) {
+        HEAP_LOCK();
+        slab_free(bp);
+        HEAP_DONE();
+        return;
     }
-    else if (!prev_alloc && next_alloc) {
-        void *prev_bp = PREV_BLKP(bp);
-        remove_from_free_list(prev_bp);
-        size += GET_SIZE(HDRP(prev_bp));
-        size_t prev_prev_alloc = GET_PREV_ALLOC(HDRP(prev_bp));
-        PUT(HDRP(prev_bp), PACK(size, 0, prev_prev_alloc));
-        PUT(FTRP(prev_bp), PACK(size, 0, prev_prev_alloc));
-        bp = prev_bp;
-        add_to_free_list(bp);
-        CLEAR_PREV_ALLOC(HDRP(next_bp));
+#endif
+
+#ifdef LARGE_TIER
+    /* LARGE_THRESHOLD 이하로는 large 블록이 생기지 않으므로 그보다 클 때만 헤더 확인 */
+    if (size > LARGE_THRESHOLD && IS_LARGE(bp)) {
+        HEAP_LOCK();
+        large_free(bp);
+        HEAP_DONE();
+        return;
     }
-    else {
-        void *prev_bp = PREV_BLKP(bp);
-        remove_from_free_list(prev_bp);
-        remove_from_free_list(next_bp);
-        size += GET_SIZE(HDRP(prev_bp)) + GET_SIZE(HDRP(next_bp));
-        size_t prev_prev_alloc = GET_PREV_ALLOC(HDRP(prev_bp));
-        PUT(HDRP(prev_bp), PACK(size, 0, prev_prev_alloc));
-        PUT(FTRP(prev_bp), PACK(size, 0, prev_prev_alloc));
-        bp = prev_bp;
-        add_to_free_list(bp);
-        CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+#endif
+
+#ifdef THREAD_CACHE
+    if (asize <= TCACHE_MAX_SIZE) {
+        tcache_free(bp, asize);
+        return;
     }
+#endif
 
-    return bp;
+    HEAP_LOCK();
+    if (!hot_push(asize, bp))
+        defer_free(bp);
+    HEAP_DONE();
 }
 
 /*
- * find_fit - asize 바이트 블록에 맞는 fit 찾기
+ * mm_try_expand - 데이터를 옮기지 않고 ptr 블록이 size 바이트를 담을 수 있게 되면 1
+ * 다음 free 블록(힙 끝이면 힙 확장)을 흡수해 본다. 이전 블록으로 넓히면
+ * payload 시작이 바뀌어 옮겨야 하므로 여기서는 하지 않는다.
+ * 실패하면 0이고 블록은 그대로
  */
-static void *find_fit(size_t asize)
+int mm_try_expand(void *ptr, size_t size)
 {
-    int index = get_seg_index(asize);
-    void *bp;
-    void *best_fit = NULL;
-    size_t best_size = 0;
+    int ok;
 
-    for (int i = index; i < SEG_LIST_COUNT; i++) {
-        bp = seg_list[i];
+    if (ptr == NULL || size == 0 || size > INT_MAX - 2 * DSIZE)
+        return 0;
 
-        if (i > index && bp != NULL) {
-            return bp;
-        }
-
-        while (bp != NULL) {
-            size_t block_size = GET_SIZE(HDRP(bp));
-            if (block_size >= asize) {
-                if (best_fit == NULL || block_size < best_size) {
-                    best_fit = bp;
-                    best_size = block_size;
-                    if (block_size == asize) {
-                        return best_fit;
-                    }
-                }
-            }
-            bp = GET_SUCC(bp);
-        }
+#ifdef SLAB_TIER
+    if (IS_SLAB(ptr))
+        return size <= RUN_OF(ptr)->slot_size;
+#endif
 
-        if (best_fit != NULL) {
-            return best_fit;
-        }
-    }
+#ifdef LARGE_TIER
+    if (IS_LARGE(ptr))
+        return size <= LARGE_LEN(ptr) - LARGE_HDR_SIZE;
+#endif
 
-    return NULL;
+    HEAP_LOCK();
+    ok = heap_expand(ptr, adjust_size(size));
+    HEAP_DONE();
+    return ok;
 }
 
 /*
- * place - asize 바이트 블록 배치 및 필요시 분할
+ * mm_usable_size - ptr 블록에 실제로 쓸 수 있는 payload 바이트 수 (요청한 size 이상)
+ * 크기 비트는 블록 주인만 바꾸므로 lock 없이 읽는다 (이웃이 lock 안에서 고치는
+ * prev_alloc 비트와 같은 워드라서 THREAD_CACHE의 GET은 relaxed atomic)
  */
-static void *place(void *bp, size_t asize)
+size_t mm_usable_size(void *ptr)
 {
-    size_t csize = GET_SIZE(HDRP(bp));
-    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+    if (ptr == NULL)
+        return 0;
 
-    remove_from_free_list(bp);
+#ifdef SLAB_TIER
+    if (IS_SLAB(ptr))
+        return RUN_OF(ptr)->slot_size;
+#endif
 
-    /* Binary mode에서 특정 크기는 splitting을 피함 */
-    size_t split_threshold = MIN_BLOCK_SIZE;
-    if (binary_mode) {
-        int idx = get_exact_fit_index(asize);
-        if (idx >= 0) {
-            split_threshold = 2 * MIN_BLOCK_SIZE;  /* 더 큰 threshold로 splitting 줄이기 */
-        }
-    }
+#ifdef LARGE_TIER
+    if (IS_LARGE(ptr))
+        return LARGE_LEN(ptr) - LARGE_HDR_SIZE;
+#endif
 
-    if ((csize - asize) >= split_threshold) {
-        /* 큰 요청은 끝에서 할당하여 작은 블록을 앞쪽에 유지 */
-        if (asize >= 112) {
-            PUT(HDRP(bp), PACK(csize - asize, 0, prev_alloc));
-            PUT(FTRP(bp), PACK(csize - asize, 0, prev_alloc));
-            add_to_free_list(bp);
-            void *next_bp = NEXT_BLKP(bp);
-            PUT(HDRP(next_bp), PACK(asize, 1, 0));
-            SET_PREV_ALLOC(HDRP(NEXT_BLKP(next_bp)));
-            return next_bp;
-        } else {
-            PUT(HDRP(bp), PACK(asize, 1, prev_alloc));
-            void *next_bp = NEXT_BLKP(bp);
-            PUT(HDRP(next_bp), PACK(csize - asize, 0, 1));
-            PUT(FTRP(next_bp), PACK(csize - asize, 0, 1));
-            add_to_free_list(next_bp);
-            return bp;
-        }
-    } else {
-        PUT(HDRP(bp), PACK(csize, 1, prev_alloc));
-        SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
-        return bp;
-    }
+    /* 할당 블록은 풋터가 없어 다음 블록 헤더 직전까지가 payload */
+    return GET_SIZE(HDRP(ptr)) - WSIZE;
 }
 
 /*
- * get_seg_index - 주어진 크기에 대한 segregated list 인덱스 반환
+ * mm_malloc_batch - size 바이트 블록 n개를 한 번에 할당해 ptrs에 채우고 개수 반환
+ * 블록 n개가 들어가는 free 블록 하나(없으면 새 힙 확장)를 찾아 앞에서부터 잘라내므로
+ * 크기 계산과 검색은 한 번뿐이고 블록들은 주소 순으로 붙어 있다.
+ * 다른 tier가 받는 크기이거나 연속 공간을 못 얻으면 하나씩 할당 (실패하면 거기까지)
  */
-static int get_seg_index(size_t size)
+size_t mm_malloc_batch(size_t size, size_t n, void **ptrs)
 {
-    if (size <= 32) return 0;
-    if (size <= 48) return 1;
-    if (size <= 64) return 2;
-    if (size <= 96) return 3;
-    if (size <= 128) return 4;
-    if (size <= 192) return 5;
-    if (size <= 256) return 6;
-    if (size <= 512) return 7;
-    if (size <= 1024) return 8;
-    if (size <= 2048) return 9;
-    if (size <= 4096) return 10;
-    if (size <= 8192) return 11;
-    if (size <= 16384) return 12;
-    if (size <= 32768) return 13;
-    return 14;
+    size_t asize, i;
+    void *bp;
+
+    if (size == 0 || n == 0 || size > INT_MAX - 2 * DSIZE)
+        return 0;
+    asize = adjust_size(size);
+
+    int one_by_one = (n == 1 || asize > (INT_MAX - 2 * DSIZE) / n);
+#ifdef THREAD_CACHE
+    one_by_one |= (asize <= TCACHE_MAX_SIZE);
+#endif
+#ifdef SLAB_TIER
+    one_by_one |= (size <= SLAB_MAX_SIZE && slab_base != NULL);
+#endif
+#ifdef LARGE_TIER
+    one_by_one |= (size > LARGE_THRESHOLD);
+#endif
+    if (one_by_one) {
+        for (i = 0; i < n; i++)
+            if ((ptrs[i] = mm_malloc(size)) == NULL)
+                break;
+        return i;
+    }
+
+    HEAP_LOCK();
+    bp = find_fit(asize * n);
+    if (bp == NULL && hot_consolidate())
+        bp = find_fit(asize * n);
+    if (bp == NULL)
+        bp = extend_heap(MAX(asize * n, params.chunk_size) / WSIZE);
+
+    if (bp != NULL) {
+        carve_batch(bp, asize, n, ptrs);
+        i = n;
+    } else {
+        for (i = 0; i < n; i++)
+            if ((ptrs[i] = heap_alloc(asize)) == NULL)
+                break;
+    }
+    HEAP_DONE();
+    return i;
 }
 
 /*
- * add_to_free_list - free 블록을 segregated list에 추가 (Address-Ordered)
- * 주소 순서로 정렬하여 coalescing 효율 향상
+ * mm_free_batch - ptrs의 블록 n개를 해제 (ptrs 배열은 주소 순으로 재배열됨)
+ * 공유 힙 블록은 정렬한 뒤 주소가 이어지는 블록끼리 하나로 합쳐서
+ * run마다 한 번만 병합하고, quick list는 거치지 않는다.
  */
-static void add_to_free_list(void *bp)
+void mm_free_batch(void **ptrs, size_t n)
 {
-    if (bp == NULL)
-        return;
+    size_t i, j, heap_n = 0;
+
+    /* 다른 tier의 블록은 바로 해제하고 힙 블록만 앞으로 모은다 */
+    for (i = 0; i < n; i++) {
+        void *bp = ptrs[i];
+        if (bp == NULL)
+            continue;
+        int other_tier = 0;
+#ifdef SLAB_TIER
+        other_tier |= IS_SLAB(bp);
+#endif
+#ifdef LARGE_TIER
+        other_tier |= (!other_tier && IS_LARGE(bp));
+#endif
+#ifdef THREAD_CACHE
+        other_tier |= (!other_tier && GET_SIZE(HDRP(bp)) <= TCACHE_MAX_SIZE);
+#endif
+        if (other_tier)
+            mm_free(bp);
+        else
+            ptrs[heap_n++] = bp;
+    }
 
-    size_t size = GET_SIZE(HDRP(bp));
-    int index = get_seg_index(size);
+    qsort(ptrs, heap_n, sizeof(void *), ptr_cmp);
 
-    /* 주소 순서로 삽입 위치 찾기 */
-    void *curr = seg_list[index];
-    void *prev = NULL;
+    HEAP_LOCK();
+    for (i = 0; i < heap_n; i = j) {
+        char *bp = ptrs[i];
+        size_t size = GET_SIZE(HDRP(bp));
 
-    /* bp보다 큰 주소를 가진 첫 블록을 찾음 */
-    while (curr != NULL && curr < bp) {
-        prev = curr;
-        curr = GET_SUCC(curr);
+        /* 바로 뒤 블록도 이번에 해제되면 하나의 할당 블록으로 합침 */
+        for (j = i + 1; j < heap_n && (char *)ptrs[j] == bp + size; j++)
+            size += GET_SIZE(HDRP(ptrs[j]));
+        PUT(HDRP(bp), PACK(size, 1, GET_PREV_ALLOC(HDRP(bp))));
+        free_block(bp);
     }
+    HEAP_DONE();
+}
 
-    /* 삽입 */
-    if (prev == NULL) {
-        /* 리스트의 맨 앞에 삽입 */
-        SET_PRED(bp, NULL);
-        SET_SUCC(bp, seg_list[index]);
-        if (seg_list[index] != NULL) {
-            SET_PRED(seg_list[index], bp);
-        }
-        seg_list[index] = bp;
-    } else {
-        /* 중간 또는 끝에 삽입 */
-        SET_PRED(bp, prev);
-        SET_SUCC(bp, curr);
-        SET_SUCC(prev, bp);
-        if (curr != NULL) {
-            SET_PRED(curr, bp);
+#ifndef THREAD_CACHE
+/*
+ * mm_fixed_refill - 빈 고정 크기 bin의 miss: asize 블록 하나를 돌려주고
+ * MM_FIXED_BATCH - 1개까지 더 할당해 bin을 채운다 (asize는 MM_ASIZE로 조정된 크기)
+ * bin 전체가 MM_FIXED_CAP을 넘지 않는 만큼만 채운다
+ */
+void *mm_fixed_refill(size_t asize)
+{
+    int bin = asize / DSIZE;
+    void *bp, *extra;
+
+    HEAP_LOCK();
+    if ((bp = heap_alloc(asize)) != NULL) {
+        for (int i = 1; i < MM_FIXED_BATCH && mm_fixed_bytes + asize <= MM_FIXED_CAP; i++) {
+            if ((extra = heap_alloc(asize)) == NULL)
+                break;
+            QL_NEXT(extra) = mm_fixed_bin[bin];
+            mm_fixed_bin[bin] = extra;
+            mm_fixed_len[bin]++;
+            mm_fixed_bytes += asize;
         }
     }
+    HEAP_DONE();
+    return bp;
 }
 
 /*
- * remove_from_free_list - segregated list에서 free 블록 제거
+ * mm_fixed_drain - 넘친 고정 크기 bin에서 MM_FIXED_BATCH개를 공유 힙에 반환
+ * bin 합계가 MM_FIXED_CAP을 넘었으면 가장 많은 바이트를 가진 bin부터 더 반환
+ */
+void mm_fixed_drain(size_t asize)
+{
+    int bin = asize / DSIZE;
+
+    HEAP_LOCK();
+    if (mm_fixed_len[bin] > MM_FIXED_BIN_MAX)
+        fixed_release(bin, MM_FIXED_BATCH);
+    while (mm_fixed_bytes > MM_FIXED_CAP) {
+        int big = 0;
+        for (int i = 1; i < MM_FIXED_BINS; i++)
+            if ((size_t)mm_fixed_len[i] * i > (size_t)mm_fixed_len[big] * big)
+                big = i;
+        fixed_release(big, MM_FIXED_BATCH);
+    }
+    HEAP_DONE();
+}
+#endif
+
+#ifdef THREAD_CACHE
+/*
+ * mm_fork_prepare - fork 직전: 다른 스레드가 공유 힙 안에 있지 않도록 lock을 잡는다
+ */
+void mm_fork_prepare(void)
+{
+    HEAP_LOCK();
+}
+
+/*
+ * mm_fork_parent - fork 후 부모: prepare에서 잡은 lock을 푼다
+ */
+void mm_fork_parent(void)
+{
+    HEAP_UNLOCK();
+}
+
+/*
+ * mm_fork_child - fork 후 자식: fork한 스레드만 남으므로 lock을 새로 만들고
+ * 나머지 cache slot을 비운다. 그 스레드들이 lock 없이 고치던 bin은 믿을 수 없어
+ * 블록을 힙에 돌려주지 않고 버린다 (자식에서는 할당된 채로 남음)
+ */
+void mm_fork_child(void)
+{
+    pthread_mutex_init(&heap_lock, NULL);
+    for (int i = 1; i <= TCACHE_MAX_THREADS; i++) {
+        tcache_t *tc = &tcaches[i];
+        if (tc == my_tcache)
+            continue;
+        memset(tc->bins, 0, sizeof(tc->bins));
+        memset(tc->counts, 0, sizeof(tc->counts));
+        atomic_store(&tc->remote, NULL);
+        atomic_store(&tc->live, 0);
+    }
+}
+#endif
+
+/*
+ * mm_set_policy - 이름으로 할당 정책 선택, 없는 이름이면 -1
+ * 이미 free list에 있는 블록은 그대로 두고 이후 탐색/삽입부터 적용된다.
+ */
+int mm_set_policy(const char *name)
+{
+    for (int i = 0; i < NUM_POLICIES; i++) {
+        if (strcmp(policies[i].name, name) == 0) {
+            policy = &policies[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * mm_policy_name - i번째 내장 정책 이름 (범위 밖이면 NULL)
+ */
+const char *mm_policy_name(int i)
+{
+    return (i >= 0 && i < NUM_POLICIES) ? policies[i].name : NULL;
+}
+
+/*
+ * mm_get_params - 현재 튜닝 파라미터를 out에 복사
+ */
+void mm_get_params(mm_params_t *out)
+{
+    *out = params;
+}
+
+/*
+ * mm_set_params - 튜닝 파라미터 교체, 범위를 벗어난 값이 있으면 -1 (아무것도 바꾸지 않음)
+ * 힙 구조에 영향을 주지 않는 값들이라 언제 바꿔도 안전하지만,
+ * 비교 실험이라면 mm_init 전에 바꾼다.
+ */
+int mm_set_params(const mm_params_t *in)
+{
+    if (in->chunk_size < MIN_BLOCK_SIZE || in->chunk_size > (1 << 24) ||
+        in->chunk_size % ALIGN_SIZE != 0)
+        return -1;
+    if (in->split_min < MIN_BLOCK_SIZE || in->split_min % ALIGN_SIZE != 0)
+        return -1;
+    if (in->hot_min_count < 1 || in->hot_cold_count > in->hot_min_count ||
+        in->hot_window < 1 || in->hot_window > UINT_MAX || in->hot_list_max > INT_MAX)
+        return -1;
+    /* 힙 끝을 줄일 때 TRIM_KEEP은 남기므로 그보다 커야 한다 */
+    if (in->trim_threshold <= TRIM_KEEP)
+        return -1;
+
+    HEAP_LOCK();
+    params = *in;
+    HEAP_UNLOCK();
+    return 0;
+}
+
+#ifdef MM_STATS
+/*
+ * mm_stats - 지금까지의 카운터를 out에 복사하고, 힙을 한 번 훑어
+ * size class별 할당/free 블록 수와 바이트를 채운다
+ * (quick list와 thread cache에 있는 블록은 할당된 것으로 센다)
+ */
+void mm_stats(mm_stats_t *out)
+{
+    HEAP_LOCK();
+    *out = stats;
+    for (int i = 0; i < HOT_SLOTS; i++)
+        out->quick_blocks += hot_len[i];
+#ifndef THREAD_CACHE
+    for (int i = 0; i < MM_FIXED_BINS; i++)
+        out->quick_blocks += mm_fixed_len[i];
+#endif
+#ifdef DEFER_COALESCE
+    out->quick_blocks += defer_count;
+#endif
+
+    for (int r = 0; r < num_heap_regions; r++) {
+        for (char *bp = heap_regions[r]; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+            size_t size = GET_SIZE(HDRP(bp));
+            int index = get_seg_index(size);
+            if (GET_ALLOC(HDRP(bp))) {
+                out->used_blocks[index]++;
+                out->used_bytes[index] += size;
+            } else {
+                out->free_blocks[index]++;
+                out->free_bytes[index] += size;
+            }
+        }
+    }
+    HEAP_UNLOCK();
+}
+
+/*
+ * mm_layout - 각 region의 블록 체인을 프롤로그부터 에필로그까지 따라가며
+ * 할당/free 블록, 가장 큰 free 블록과 free 블록 크기 분포를 기록
+ */
+void mm_layout(mm_layout_t *out)
+{
+    memset(out, 0, sizeof(*out));
+
+    HEAP_LOCK();
+    for (int i = 0; i < HOT_SLOTS; i++) {
+        out->quick_blocks += hot_len[i];
+        out->quick_bytes += hot_len[i] * hot_size[i];
+    }
+#ifndef THREAD_CACHE
+    for (int i = 0; i < MM_FIXED_BINS; i++) {
+        out->quick_blocks += mm_fixed_len[i];
+        out->quick_bytes += mm_fixed_len[i] * i * DSIZE;
+    }
+#endif
+#ifdef DEFER_COALESCE
+    for (int i = 0; i < SEG_LIST_COUNT; i++)
+        for (void *bp = defer_list[i]; bp != NULL; bp = QL_NEXT(bp)) {
+            out->quick_blocks++;
+            out->quick_bytes += GET_SIZE(HDRP(bp));
+        }
+#endif
+
+    for (int r = 0; r < num_heap_regions; r++) {
+        char *bp;
+        /* 패딩, 프롤로그 헤더/풋터와 에필로그 */
+        out->overhead_bytes += 4 * WSIZE;
+        for (bp = heap_regions[r]; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+            size_t size = GET_SIZE(HDRP(bp));
+            if (GET_ALLOC(HDRP(bp))) {
+                out->used_blocks++;
+                out->used_bytes += size;
+                continue;
+            }
+            int bucket = (31 - __builtin_clz((unsigned int)size)) - 4;
+            out->free_blocks++;
+            out->free_bytes += size;
+            out->free_hist[MIN(MAX(bucket, 0), MM_LAYOUT_BUCKETS - 1)]++;
+            if (size > out->largest_free)
+                out->largest_free = size;
+        }
+    }
+    HEAP_UNLOCK();
+}
+#endif
+
+#ifdef MM_CHECK
+/*
+ * mm_check - 힙 전체 검사: 각 region의 블록 체인, free index와 class bitmap
+ * 찾은 문제를 stderr에 출력하고 개수를 반환 (0이면 정상)
+ */
+int mm_check(void)
+{
+    int problems;
+
+    HEAP_LOCK();
+    problems = check_heap();
+    HEAP_UNLOCK();
+    return problems;
+}
+
+/*
+ * mm_set_check - 공유 힙 연산이 끝날 때마다 하는 자동 검사 설정
+ * MM_CHECK_SAMPLE이면 every번째 연산마다 전체 검사 (0은 1로 취급)
+ */
+void mm_set_check(int mode, unsigned long every)
+{
+    HEAP_LOCK();
+    check_mode = mode;
+    check_every = every ? every : 1;
+    check_touched = 0;
+    HEAP_UNLOCK();
+}
+#endif
+
+/*
+ * adjust_size - 요청 크기를 블록 크기로 조정 (오버헤드 및 정렬 요구사항 포함)
+ * free 시 PRED/SUCC/풋터가 들어가야 하므로 MIN_BLOCK_SIZE보다 작게 만들지 않음
+ */
+static inline size_t adjust_size(size_t size)
+{
+#if defined(COMPACT_LINKS) || defined(ALIGN16)
+    /* 할당 블록은 헤더(WSIZE)만 더하면 된다 */
+    if (size <= MIN_BLOCK_SIZE - WSIZE)
+        return MIN_BLOCK_SIZE;
+    return ALIGN_SIZE * ((size + WSIZE + (ALIGN_SIZE - 1)) / ALIGN_SIZE);
+#else
+    if (size <= 2 * DSIZE)
+        return MIN_BLOCK_SIZE;
+    return DSIZE * ((size + (DSIZE) + (DSIZE - 1)) / DSIZE);
+#endif
+}
+
+/*
+ * heap_alloc - 공유 힙에서 asize 바이트 블록 할당
+ */
+static void *heap_alloc(size_t asize)
+{
+    size_t extendsize;
+    void *bp;
+    int slot;
+
+    /* hot 크기면 quick list에서 바로 */
+    if ((slot = hot_record(asize)) >= 0 && hot_list[slot] != NULL) {
+        bp = hot_list[slot];
+        hot_list[slot] = QL_NEXT(bp);
+        hot_len[slot]--;
+        STAT_INC(quick_hits);
+        CHECK_TOUCH(bp);
+        return bp;
+    }
+
+#ifdef DEFER_COALESCE
+    /* 병합을 기다리는 같은 class 블록이 맞으면 그대로 */
+    if ((bp = defer_take(asize)) != NULL)
+        return bp;
+#endif
+
+    /* Free list에서 fit 검색 */
+    bp = find_fit(asize);
+
+    /* 힙을 늘리기 전에 quick list(와 미뤄 둔 블록)를 병합해서 한 번 더 */
+    if (bp == NULL && hot_consolidate())
+        bp = find_fit(asize);
+
+    if (bp != NULL) {
+        return place(bp, asize);
+    }
+
+    /* Fit을 찾지 못함. 메모리 확장 후 블록 배치 */
+    extendsize = MAX(asize, params.chunk_size);
+    if ((bp = extend_heap(extendsize / WSIZE)) == NULL)
+        return NULL;
+    return place(bp, asize);
+}
+
+/*
+ * heap_free - 블록을 공유 힙에 반환
+ * hot 크기면 quick list에 그대로 넣고, 아니면 free_block으로 병합
+ */
+static void heap_free(void *bp)
+{
+    if (!hot_push(GET_SIZE(HDRP(bp)), bp))
+        defer_free(bp);
+}
+
+/*
+ * defer_free - 블록을 free (DEFER_COALESCE면 병합을 미루고 unsorted 리스트로)
+ */
+static void defer_free(void *bp)
+{
+#ifdef DEFER_COALESCE
+    int index = get_seg_index(GET_SIZE(HDRP(bp)));
+
+    QL_NEXT(bp) = defer_list[index];
+    defer_list[index] = bp;
+    CHECK_TOUCH(bp);
+    STAT_INC(deferred_frees);
+    if (++defer_count > DEFER_MAX)
+        defer_drain(DEFER_BATCH);
+#else
+    free_block(bp);
+#endif
+}
+
+/*
+ * free_block - 블록을 free로 표시하고 인접 free 블록과 병합
+ */
+static void free_block(void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+    char *lo = bp, *hi = (char *)bp + size;     /* 이번에 새로 free가 된 범위 */
+    char *next_bp = NEXT_BLKP(bp);
+
+    /* threshold 이상인 이웃은 free가 될 때 이미 반환했으므로 범위에서 뺀다 */
+    if (!prev_alloc && GET_SIZE(HDRP(PREV_BLKP(bp))) < params.trim_threshold)
+        lo = PREV_BLKP(bp);
+    if (!GET_ALLOC(HDRP(next_bp)) && GET_SIZE(HDRP(next_bp)) < params.trim_threshold)
+        hi = next_bp + GET_SIZE(HDRP(next_bp));
+
+    CHECK_UNTOUCH(bp);
+    PUT(HDRP(bp), PACK(size, 0, prev_alloc));
+    PUT(FTRP(bp), PACK(size, 0, prev_alloc));
+
+    /* 일반 coalescing */
+    bp = coalesce(bp);
+
+    /* 병합 결과가 크면 OS에 반환 */
+    if (GET_SIZE(HDRP(bp)) >= params.trim_threshold)
+        release_free_block(bp, lo, hi);
+}
+
+/*
+ * release_free_block - 큰 free 블록의 메모리를 OS에 반환
+ * 힙 끝 블록이면 TRIM_KEEP만 남기고 brk를 내리고, 내부 블록이면
+ * 헤더/PRED/SUCC/풋터를 제외한 페이지 중 새로 free가 된 [lo, hi)에 걸친 것만
+ * mem_release로 넘긴다 (나머지는 먼저 반환되었으므로 다시 madvise하지 않는다)
+ */
+static void release_free_block(void *bp, char *lo, char *hi)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+    size_t shrink = size - TRIM_KEEP, done;
+    char *next_bp = NEXT_BLKP(bp);
+
+    if (next_bp == (char *)mem_heap_hi() + 1) {
+        /* 힙 끝 (에필로그 바로 앞): 2 GB 이상도 int로 넘치지 않게 TRIM_STEP씩 */
+        remove_from_free_list(bp);
+        for (done = 0; done < shrink; done += MIN(shrink - done, TRIM_STEP))
+            if ((long)mem_sbrk(-(int)MIN(shrink - done, TRIM_STEP)) == -1)
+                break;
+        /* brk가 실제로 내려간 만큼만 블록을 줄인다 */
+        done = next_bp - ((char *)mem_heap_hi() + 1);
+        if (done > 0 && done <= shrink) {
+            STAT_INC(trim_calls);
+            STAT_ADD(trim_bytes, done);
+            size -= done;
+            PUT(HDRP(bp), PACK(size, 0, prev_alloc));
+            PUT(FTRP(bp), PACK(size, 0, prev_alloc));
+            PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1, 0));
+        }
+        add_to_free_list(bp);
+        return;
+    }
+
+    /*
+     * 내부 블록: [bp + FREE_META, FTRP(bp)) 안의 페이지. 경계 페이지는 예전 이웃의
+     * 반환 범위에서 빠졌을 수 있으므로 [lo, hi)를 페이지 단위로 넓혀서 자른다
+     */
+    size_t pagesize = mem_hugepagesize();
+    lo = (char *)((uintptr_t)lo & ~(uintptr_t)(pagesize - 1));
+    hi = (char *)(((uintptr_t)hi + pagesize - 1) & ~(uintptr_t)(pagesize - 1));
+    lo = MAX(lo, (char *)bp + FREE_META);
+    hi = MIN(hi, (char *)FTRP(bp));
+    if (lo >= hi)
+        return;
+    STAT_INC(release_calls);
+    STAT_ADD(release_bytes, hi - lo);
+    mem_release(lo, hi - lo);
+}
+
+/*
+ * heap_realloc - 인접 블록 활용으로 복사를 최소화하는 realloc
+ * 순서: 크게 줄면 분할, 다음 블록 흡수, 이전 블록 흡수(memmove), 힙 끝 확장, 이동
+ */
+static void *heap_realloc(void *ptr, size_t size)
+{
+    void *newptr;
+    size_t oldsize = GET_SIZE(HDRP(ptr));
+    size_t asize = adjust_size(size);
+
+    /* 절반 이하로 줄면 뒤쪽을 잘라 free (조금 줄 때는 다시 커질 여유로 둔다) */
+    if (asize <= oldsize / 2 && oldsize - asize >= params.split_min) {
+        heap_shrink(ptr, asize);
+        return ptr;
+    }
+
+    /* 다음 블록만으로 충분하면 그쪽이 memmove 없이 끝난다 */
+    void *next_bp = NEXT_BLKP(ptr);
+    int fits_fwd = asize <= oldsize ||
+        (!GET_ALLOC(HDRP(next_bp)) && oldsize + GET_SIZE(HDRP(next_bp)) >= asize);
+    if (fits_fwd && heap_expand(ptr, asize))
+        return ptr;
+
+    /* free인 이전 블록(+ 다음 블록)과 합쳐 앞으로 옮긴다 */
+    if ((newptr = heap_expand_back(ptr, asize)) != NULL)
+        return newptr;
+
+    /* 힙 끝이면 힙을 늘려 제자리 확장 */
+    if (heap_expand(ptr, asize))
+        return ptr;
+
+    /* 새 블록 할당 */
+    newptr = heap_alloc(asize);
+    if (newptr == NULL)
+        return NULL;
+
+    memcpy(newptr, ptr, oldsize - WSIZE);
+    heap_free(ptr);
+    STAT_INC(realloc_moved);
+    return newptr;
+}
+
+/*
+ * heap_expand - 데이터를 옮기지 않고 ptr 블록을 asize 이상으로 만들면 1
+ * 이미 충분하거나, 다음 free 블록을 흡수하거나, 힙 끝이면 힙을 늘려서 흡수
+ * 흡수한 블록에서 asize를 넘는 부분은 split_min 이상이면 다시 free 블록으로
+ */
+static int heap_expand(void *ptr, size_t asize)
+{
+    size_t oldsize, next_size;
+    size_t combined_size;
+
+    oldsize = GET_SIZE(HDRP(ptr));
+
+    if (asize <= oldsize) {
+        CHECK_TOUCH(ptr);
+        STAT_INC(realloc_in_place);
+        return 1;
+    }
+
+    /* 다음 블록이 free면 확장 시도 */
+    void *next_bp = NEXT_BLKP(ptr);
+    next_size = GET_SIZE(HDRP(next_bp));
+    int next_alloc = GET_ALLOC(HDRP(next_bp));
+
+    /* 힙 끝 블록이면 모자란 만큼만 힙을 늘려 제자리 확장 */
+    char *heap_end = (char *)mem_heap_hi() + 1;
+    if ((char *)next_bp == heap_end ||
+        (!next_alloc && oldsize + next_size < asize && NEXT_BLKP(next_bp) == heap_end)) {
+        size_t avail = next_alloc ? 0 : next_size;
+        size_t need = MAX(asize - oldsize - avail, MIN_BLOCK_SIZE);
+        if (extend_heap(need / WSIZE) == next_bp) {
+            next_size = GET_SIZE(HDRP(next_bp));
+            next_alloc = 0;
+            STAT_INC(realloc_grew_top);
+        }
+    }
+
+    if (!next_alloc && (oldsize + next_size) >= asize) {
+        remove_from_free_list(next_bp);
+        combined_size = oldsize + next_size;
+        size_t prev_alloc = GET_PREV_ALLOC(HDRP(ptr));
+        PUT(HDRP(ptr), PACK(combined_size, 1, prev_alloc));
+        SET_PREV_ALLOC(HDRP(NEXT_BLKP(ptr)));
+
+        /* heap_expand_back처럼 남는 뒤쪽이 split_min 이상이면 잘라 free로 */
+        if (combined_size - asize >= params.split_min) {
+            void *rest;
+
+            PUT(HDRP(ptr), PACK(asize, 1, prev_alloc));
+            rest = NEXT_BLKP(ptr);
+            PUT(HDRP(rest), PACK(combined_size - asize, 1, 1));
+            free_block(rest);
+        }
+        CHECK_TOUCH(ptr);
+        STAT_INC(realloc_in_place);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * heap_expand_back - free인 이전 블록(다음 블록도 free면 함께)을 흡수해 asize 확보
+ * payload를 이전 블록 자리로 memmove하고 새 bp 반환, 모자라면 NULL (블록은 그대로)
+ */
+static void *heap_expand_back(void *ptr, size_t asize)
+{
+    size_t oldsize = GET_SIZE(HDRP(ptr));
+    void *next_bp = NEXT_BLKP(ptr);
+    size_t next_size = GET_ALLOC(HDRP(next_bp)) ? 0 : GET_SIZE(HDRP(next_bp));
+    void *prev_bp;
+    size_t size;
+
+    if (GET_PREV_ALLOC(HDRP(ptr)))
+        return NULL;
+    prev_bp = PREV_BLKP(ptr);
+    size = GET_SIZE(HDRP(prev_bp)) + oldsize + next_size;
+    if (size < asize)
+        return NULL;
+
+    remove_from_free_list(prev_bp);
+    if (next_size)
+        remove_from_free_list(next_bp);
+
+    /* 이전 블록의 PRED/SUCC를 다 쓴 뒤에 덮어쓴다 */
+    memmove(prev_bp, ptr, oldsize - WSIZE);
+    PUT(HDRP(prev_bp), PACK(size, 1, GET_PREV_ALLOC(HDRP(prev_bp))));
+    SET_PREV_ALLOC(HDRP(NEXT_BLKP(prev_bp)));
+
+    /* 큰 이전 블록을 통째로 붙잡지 않게, 남는 뒤쪽은 place처럼 잘라 free로 */
+    if (size - asize >= params.split_min) {
+        void *rest;
+
+        PUT(HDRP(prev_bp), PACK(asize, 1, GET_PREV_ALLOC(HDRP(prev_bp))));
+        rest = NEXT_BLKP(prev_bp);
+        PUT(HDRP(rest), PACK(size - asize, 1, 1));
+        free_block(rest);
+    }
+    CHECK_TOUCH(prev_bp);
+    STAT_INC(realloc_grew_back);
+    return prev_bp;
+}
+
+/*
+ * heap_shrink - ptr 블록을 asize로 줄이고 남는 뒤쪽을 free 블록으로 (다음 free와 병합)
+ */
+static void heap_shrink(void *ptr, size_t asize)
+{
+    size_t oldsize = GET_SIZE(HDRP(ptr));
+    void *rest;
+
+    PUT(HDRP(ptr), PACK(asize, 1, GET_PREV_ALLOC(HDRP(ptr))));
+    rest = NEXT_BLKP(ptr);
+    PUT(HDRP(rest), PACK(oldsize - asize, 1, 1));
+    free_block(rest);
+    CHECK_TOUCH(ptr);
+    STAT_INC(realloc_shrunk);
+}
+
+/*
+ * extend_heap - free 블록으로 힙 확장
+ */
+static void *extend_heap(size_t words)
+{
+    char *bp;
+    size_t size;
+    size_t prev_alloc;
+    char *old_brk = (char *)mem_heap_hi() + 1;  /* 인접 여부 판단용 */
+
+    size = (words * WSIZE + ALIGN_SIZE - 1) & ~(size_t)(ALIGN_SIZE - 1);
+#ifdef MEMLIB_HUGE
+    /* 새 brk를 hugepage 경계까지 올려 힙이 hugepage 단위로 자라게 한다 */
+    size += -(uintptr_t)(old_brk + size) & (mem_hugepagesize() - 1);
+#endif
+    if (size > INT_MAX - 2 * DSIZE)
+        return NULL;
+    if ((long)(bp = mem_sbrk(size)) == -1)
+        return NULL;
+
+    if (bp != old_brk) {
+        /*
+         * 새 region: 이전 region의 에필로그는 그대로 두고 패딩과 프롤로그를 새로 만든다.
+         * 그만큼(2 * DSIZE) 더 받아서 블록 크기는 요청대로 유지
+         */
+        char *pad = mem_sbrk(2 * DSIZE);
+        int usable = num_heap_regions < MAX_HEAP_REGIONS && pad == bp + size;
+#ifdef COMPACT_LINKS
+        /*
+         * 32비트 offset이 닿지 않는 region의 블록은 free list에 넣을 수 없다.
+         * mmap은 보통 다음 region을 heap_base 아래에 두므로 COMPACT에서는
+         * 두 번째 region이 거의 쓰이지 못하고, 힙은 첫 region(4 GB)에서 멈춘다
+         */
+        usable = usable && (size_t)(bp + 2 * DSIZE + size - heap_base) <= UINT_MAX;
+#endif
+        if (!usable) {
+            /* 받은 만큼 되돌려 빈 region을 memlib이 닫게 한다 (brk는 이전 region 끝으로) */
+            if ((long)pad != -1)
+                mem_sbrk(-2 * DSIZE);
+            mem_sbrk(-(int)size);
+            return NULL;
+        }
+        PUT(bp, 0);                                /* 정렬 패딩 */
+        PUT(bp + (1 * WSIZE), PACK(DSIZE, 1, 1));  /* 프롤로그 헤더 */
+        PUT(bp + (2 * WSIZE), PACK(DSIZE, 1, 1));  /* 프롤로그 풋터 */
+        PUT(bp + (3 * WSIZE), PACK(0, 1, 1));      /* 임시 에필로그 (prev_alloc 전달용) */
+        bp += 2 * DSIZE;
+        heap_regions[num_heap_regions++] = bp;
+        STAT_INC(new_regions);
+    }
+    STAT_INC(extend_calls);
+    STAT_ADD(extend_bytes, size);
+
+    prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+
+    PUT(HDRP(bp), PACK(size, 0, prev_alloc));
+    PUT(FTRP(bp), PACK(size, 0, prev_alloc));
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1, 0));
+
+    return coalesce(bp);
+}
+
+/*
+ * coalesce - 인접한 free 블록들과 병합
+ */
+static void *coalesce(void *bp)
+{
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+    void *next_bp = NEXT_BLKP(bp);
+    size_t next_alloc = GET_ALLOC(HDRP(next_bp));
+    size_t size = GET_SIZE(HDRP(bp));
+
+    STAT_INC(coalesce_cases[(!prev_alloc << 1) | !next_alloc]);
+
+    if (prev_alloc && next_alloc) {
+        add_to_free_list(bp);
+        CLEAR_PREV_ALLOC(HDRP(next_bp));
+        return bp;
+    }
+    else if (prev_alloc && !next_alloc) {
+        remove_from_free_list(next_bp);
+        size += GET_SIZE(HDRP(next_bp));
+        PUT(HDRP(bp), PACK(size, 0, 1));
+        PUT(FTRP(bp), PACK(size, 0, 1));
+        add_to_free_list(bp);
+        CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+    }
+    else if (!prev_alloc && next_alloc) {
+        void *prev_bp = PREV_BLKP(bp);
+        remove_from_free_list(prev_bp);
+        size += GET_SIZE(HDRP(prev_bp));
+        size_t prev_prev_alloc = GET_PREV_ALLOC(HDRP(prev_bp));
+        PUT(HDRP(prev_bp), PACK(size, 0, prev_prev_alloc));
+        PUT(FTRP(prev_bp), PACK(size, 0, prev_prev_alloc));
+        bp = prev_bp;
+        add_to_free_list(bp);
+        CLEAR_PREV_ALLOC(HDRP(next_bp));
+    }
+    else {
+        void *prev_bp = PREV_BLKP(bp);
+        remove_from_free_list(prev_bp);
+        remove_from_free_list(next_bp);
+        size += GET_SIZE(HDRP(prev_bp)) + GET_SIZE(HDRP(next_bp));
+        size_t prev_prev_alloc = GET_PREV_ALLOC(HDRP(prev_bp));
+        PUT(HDRP(prev_bp), PACK(size, 0, prev_prev_alloc));
+        PUT(FTRP(prev_bp), PACK(size, 0, prev_prev_alloc));
+        bp = prev_bp;
+        add_to_free_list(bp);
+        CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+    }
+
+    return bp;
+}
+
+/*
+ * find_fit - asize 바이트 블록에 맞는 fit 찾기
+ */
+#ifdef INDEX_TREE
+static void *find_fit(size_t asize)
+{
+    /* class 트리에서 (asize, 0) 이상인 가장 작은 키 = best fit, 같은 크기면 낮은 주소 */
+    int index = get_seg_index(asize);
+    void *bp = NULL;
+
+    STAT_INC(fit_calls);
+    STAT_WALK_BEGIN();
+    if (seg_list[index] != NULL)
+        bp = policy->fit(index, asize);
+
+    /* 더 큰 클래스의 블록은 모두 asize 이상 */
+    if (bp == NULL && (index = next_class(index)) >= 0)
+        bp = policy->fit(index, asize);
+
+    STAT_WALK_END(fit);
+    if (bp == NULL)
+        STAT_INC(fit_misses);
+    return bp;
+}
+#else
+static void *find_fit(size_t asize)
+{
+    int index = get_seg_index(asize);
+    void *bp;
+
+    STAT_INC(fit_calls);
+    STAT_WALK_BEGIN();
+
+    /* 자기 클래스에서는 정책대로 탐색 */
+    bp = policy->fit(index, asize);
+
+    /* 더 큰 클래스의 블록은 모두 asize 이상이므로 첫 블록 */
+    if (bp == NULL && (index = next_class(index)) >= 0)
+        bp = seg_list[index];
+
+    STAT_WALK_END(fit);
+    if (bp == NULL)
+        STAT_INC(fit_misses);
+    return bp;
+}
+
+/*
+ * fit_best - class 리스트 전체에서 best fit (같은 크기를 찾으면 바로 멈춤)
+ */
+static void *fit_best(int index, size_t asize)
+{
+    void *bp;
+    void *best_fit = NULL;
+    size_t best_size = 0;
+
+    for (bp = seg_list[index]; bp != NULL; bp = GET_SUCC(bp)) {
+        size_t block_size = GET_FSIZE(bp);
+        PREFETCH(GET_SUCC(bp));
+        STAT_STEP();
+        if (block_size >= asize) {
+            if (best_fit == NULL || block_size < best_size) {
+                best_fit = bp;
+                best_size = block_size;
+                if (block_size == asize) {
+                    break;
+                }
+            }
+        }
+    }
+    return best_fit;
+}
+
+/*
+ * fit_good - 맞는 블록을 GOOD_FIT_SCAN개까지만 보고 그중 best (탐색 길이 제한)
+ */
+static void *fit_good(int index, size_t asize)
+{
+    void *bp;
+    void *best_fit = NULL;
+    size_t best_size = 0;
+    int seen = 0;
+
+    for (bp = seg_list[index]; bp != NULL; bp = GET_SUCC(bp)) {
+        size_t block_size = GET_FSIZE(bp);
+        PREFETCH(GET_SUCC(bp));
+        STAT_STEP();
+        if (block_size < asize)
+            continue;
+        if (best_fit == NULL || block_size < best_size) {
+            best_fit = bp;
+            best_size = block_size;
+        }
+        if (block_size == asize || ++seen == GOOD_FIT_SCAN)
+            break;
+    }
+    return best_fit;
+}
+
+/*
+ * fit_first - class 리스트에서 처음 맞는 블록
+ */
+static void *fit_first(int index, size_t asize)
+{
+    void *bp;
+
+    for (bp = seg_list[index]; bp != NULL; bp = GET_SUCC(bp)) {
+        PREFETCH(GET_SUCC(bp));
+        STAT_STEP();
+        if (GET_FSIZE(bp) >= asize)
+            return bp;
+    }
+    return NULL;
+}
+
+/*
+ * fit_next - 지난번에 멈춘 블록부터 first fit, 끝에 닿으면 리스트 앞으로 돌아감
+ * rover는 고른 블록을 가리키고, 그 블록이 리스트에서 빠지면 다음 블록으로 옮겨진다.
+ */
+static void *fit_next(int index, size_t asize)
+{
+    void *start = rover[index] != NULL ? rover[index] : seg_list[index];
+    void *bp;
+
+    for (bp = start; bp != NULL; bp = GET_SUCC(bp)) {
+        PREFETCH(GET_SUCC(bp));
+        STAT_STEP();
+        if (GET_FSIZE(bp) >= asize)
+            return rover[index] = bp;
+    }
+    for (bp = seg_list[index]; bp != start; bp = GET_SUCC(bp)) {
+        PREFETCH(GET_SUCC(bp));
+        STAT_STEP();
+        if (GET_FSIZE(bp) >= asize)
+            return rover[index] = bp;
+    }
+    return NULL;
+}
+#endif
+
+/*
+ * place - asize 바이트 블록 배치 및 필요시 분할
+ */
+static void *place(void *bp, size_t asize)
+{
+    size_t csize = GET_SIZE(HDRP(bp));
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+
+    remove_from_free_list(bp);
+    STAT_INC(place_calls);
+
+    if ((csize - asize) >= params.split_min) {
+        /* 큰 요청은 끝에서 할당하여 작은 블록을 앞쪽에 유지 */
+        if (asize >= (params.split_high ? params.split_high : policy->split_high)) {
+            STAT_INC(split_high);
+            PUT(HDRP(bp), PACK(csize - asize, 0, prev_alloc));
+            PUT(FTRP(bp), PACK(csize - asize, 0, prev_alloc));
+            add_to_free_list(bp);
+            void *next_bp = NEXT_BLKP(bp);
+            PUT(HDRP(next_bp), PACK(asize, 1, 0));
+            SET_PREV_ALLOC(HDRP(NEXT_BLKP(next_bp)));
+            CHECK_TOUCH(next_bp);
+            return next_bp;
+        } else {
+            STAT_INC(split_low);
+            PUT(HDRP(bp), PACK(asize, 1, prev_alloc));
+            void *next_bp = NEXT_BLKP(bp);
+            PUT(HDRP(next_bp), PACK(csize - asize, 0, 1));
+            PUT(FTRP(next_bp), PACK(csize - asize, 0, 1));
+            add_to_free_list(next_bp);
+            CHECK_TOUCH(bp);
+            return bp;
+        }
+    } else {
+        STAT_INC(no_split);
+        PUT(HDRP(bp), PACK(csize, 1, prev_alloc));
+        SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+        CHECK_TOUCH(bp);
+        return bp;
+    }
+}
+
+/*
+ * place_aligned - free 블록 bp에서 payload가 align 경계에 오는 asize 블록을 잘라 반환
+ * 앞 조각은 MIN_BLOCK_SIZE 이상이어야 free 블록이 되므로 모자라면 다음 경계로 넘긴다.
+ * bp는 병합이 끝난 free 블록이라 양옆이 할당 상태여서, 앞뒤 조각은 병합 없이 free list로
+ */
+static void *place_aligned(void *bp, size_t asize, size_t align)
+{
+    size_t csize = GET_SIZE(HDRP(bp));
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+    char *ap = (char *)(((uintptr_t)bp + align - 1) & ~(uintptr_t)(align - 1));
+    size_t lead;
+
+    if (ap != (char *)bp && (size_t)(ap - (char *)bp) < MIN_BLOCK_SIZE)
+        ap += align;
+    lead = ap - (char *)bp;
+
+    remove_from_free_list(bp);
+    STAT_INC(place_calls);
+
+    if (lead > 0) {
+        PUT(HDRP(bp), PACK(lead, 0, prev_alloc));
+        PUT(FTRP(bp), PACK(lead, 0, prev_alloc));
+        add_to_free_list(bp);
+        prev_alloc = 0;
+    }
+    csize -= lead;
+
+    if (csize - asize >= params.split_min) {
+        STAT_INC(split_low);
+        PUT(HDRP(ap), PACK(asize, 1, prev_alloc));
+        void *next_bp = NEXT_BLKP(ap);
+        PUT(HDRP(next_bp), PACK(csize - asize, 0, 1));
+        PUT(FTRP(next_bp), PACK(csize - asize, 0, 1));
+        add_to_free_list(next_bp);
+    } else {
+        STAT_INC(no_split);
+        PUT(HDRP(ap), PACK(csize, 1, prev_alloc));
+        SET_PREV_ALLOC(HDRP(NEXT_BLKP(ap)));
+    }
+    CHECK_TOUCH(ap);
+    return ap;
+}
+
+/*
+ * get_seg_index - 주어진 크기에 대한 segregated list 인덱스 반환 (fl * SL_COUNT + sl)
+ */
+static inline int get_seg_index(size_t size)
+{
+    int msb, fl, sl;
+
+    if (size < (1 << FL_SHIFT))
+        return size / DSIZE;
+
+    msb = 31 - __builtin_clz((unsigned int)size);
+    fl = msb - FL_SHIFT + 1;
+    sl = (size >> (msb - SL_LOG2)) & (SL_COUNT - 1);
+    return fl * SL_COUNT + sl;
+}
+
+/*
+ * next_class - index보다 큰 클래스 중 비어 있지 않은 첫 클래스, 없으면 -1
+ */
+static inline int next_class(int index)
+{
+    int fl = index / SL_COUNT;
+    int sl = index % SL_COUNT + 1;
+    unsigned int map = (sl < SL_COUNT) ? sl_bitmap[fl] & (~0u << sl) : 0;
+
+    if (map == 0) {
+        map = fl_bitmap & (~0u << (fl + 1));
+        if (map == 0)
+            return -1;
+        fl = __builtin_ctz(map);
+        map = sl_bitmap[fl];
+    }
+    return fl * SL_COUNT + __builtin_ctz(map);
+}
+
+/*
+ * mark_class - 클래스에 블록이 들어왔음을 bitmap에 표시
+ */
+static inline void mark_class(int index)
+{
+    fl_bitmap |= 1u << (index / SL_COUNT);
+    sl_bitmap[index / SL_COUNT] |= 1u << (index % SL_COUNT);
+}
+
+/*
+ * unmark_class - 클래스가 비었으면 bitmap에서 지움
+ */
+static inline void unmark_class(int index)
+{
+    if (seg_list[index] != NULL)
+        return;
+    sl_bitmap[index / SL_COUNT] &= ~(1u << (index % SL_COUNT));
+    if (sl_bitmap[index / SL_COUNT] == 0)
+        fl_bitmap &= ~(1u << (index / SL_COUNT));
+}
+
+#ifdef INDEX_TREE
+/*
+ * tree_insert - free 블록을 size class 트리에 삽입
+ * 삽입 위치로 splay한 뒤 bp를 새 루트로 만듦
+ */
+static void tree_insert(int index, void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    void *root = seg_list[index];
+
+    if (root == NULL) {
+        SET_LEFT(bp, NULL);
+        SET_RIGHT(bp, NULL);
+    } else {
+        root = tree_splay(root, size, bp);
+        if (tree_cmp(size, bp, root) < 0) {
+            SET_LEFT(bp, GET_LEFT(root));
+            SET_RIGHT(bp, root);
+            SET_LEFT(root, NULL);
+        } else {
+            SET_RIGHT(bp, GET_RIGHT(root));
+            SET_LEFT(bp, root);
+            SET_RIGHT(root, NULL);
+        }
+    }
+    seg_list[index] = bp;
+}
+
+/*
+ * remove_from_free_list - size class 트리에서 free 블록 제거
+ * bp를 루트로 splay한 뒤 왼쪽 서브트리의 최대값을 새 루트로 올림
+ */
+static void remove_from_free_list(void *bp)
+{
+    if (bp == NULL)
+        return;
+    CHECK_UNTOUCH(bp);
+
+    size_t size = GET_SIZE(HDRP(bp));
+    int index = get_seg_index(size);
+    void *root = tree_splay(seg_list[index], size, bp);
+
+    assert(root == bp);
+    if (GET_LEFT(root) == NULL) {
+        seg_list[index] = GET_RIGHT(root);
+    } else {
+        /* 왼쪽 서브트리의 모든 키는 bp보다 작으므로 splay 결과 루트의 오른쪽은 비어 있음 */
+        void *left = tree_splay(GET_LEFT(root), size, bp);
+        SET_RIGHT(left, GET_RIGHT(root));
+        seg_list[index] = left;
+    }
+    unmark_class(index);
+}
+#else
+/*
+ * insert_addr - free 블록을 class 리스트에 주소 순서로 삽입
+ * 주소 순서로 정렬하여 coalescing 효율 향상
+ */
+static void insert_addr(int index, void *bp)
+{
+    /* 주소 순서로 삽입 위치 찾기 */
+    void *curr = seg_list[index];
+    void *prev = NULL;
+
+    /* bp보다 큰 주소를 가진 첫 블록을 찾음 */
+    while (curr != NULL && curr < bp) {
+        STAT_STEP();
+        prev = curr;
+        curr = GET_SUCC(curr);
+    }
+
+    /* 삽입 */
+    if (prev == NULL) {
+        /* 리스트의 맨 앞에 삽입 */
+        SET_PRED(bp, NULL);
+        SET_SUCC(bp, seg_list[index]);
+        if (seg_list[index] != NULL) {
+            SET_PRED(seg_list[index], bp);
+        }
+        seg_list[index] = bp;
+    } else {
+        /* 중간 또는 끝에 삽입 */
+        SET_PRED(bp, prev);
+        SET_SUCC(bp, curr);
+        SET_SUCC(prev, bp);
+        if (curr != NULL) {
+            SET_PRED(curr, bp);
+        }
+    }
+}
+
+/*
+ * insert_lifo - free 블록을 class 리스트 맨 앞에 삽입 (O(1))
+ */
+static void insert_lifo(int index, void *bp)
+{
+    SET_PRED(bp, NULL);
+    SET_SUCC(bp, seg_list[index]);
+    if (seg_list[index] != NULL)
+        SET_PRED(seg_list[index], bp);
+    seg_list[index] = bp;
+}
+
+/*
+ * remove_from_free_list - segregated list에서 free 블록 제거
  */
 static void remove_from_free_list(void *bp)
 {
-    if (bp == NULL)
-        return;
+    if (bp == NULL)
+        return;
+    CHECK_UNTOUCH(bp);
+
+    size_t size = GET_SIZE(HDRP(bp));
+    int index = get_seg_index(size);
+
+    void *pred = GET_PRED(bp);
+    void *succ = GET_SUCC(bp);
+
+    if (rover[index] == bp)
+        rover[index] = succ;
+    if (pred == NULL) {
+        seg_list[index] = succ;
+        unmark_class(index);
+    } else {
+        SET_SUCC(pred, succ);
+    }
+
+    if (succ != NULL) {
+        SET_PRED(succ, pred);
+    }
+}
+#endif
+
+/*
+ * add_to_free_list - free 블록을 자기 size class에 정책의 순서대로 추가
+ */
+static void add_to_free_list(void *bp)
+{
+    if (bp == NULL)
+        return;
+
+    int index = get_seg_index(GET_SIZE(HDRP(bp)));
+
+    SET_FSIZE(bp);
+    CHECK_TOUCH(bp);
+    STAT_INC(insert_calls);
+    STAT_WALK_BEGIN();
+    policy->insert(index, bp);
+    STAT_WALK_END(insert);
+    mark_class(index);
+}
+
+/*
+ * ========== Hot-size cache Helper 함수들 ==========
+ */
+
+/*
+ * hot_slot - asize가 hot이면 slot 번호, 아니면 -1
+ */
+static int hot_slot(size_t asize)
+{
+    for (int i = 0; i < HOT_SLOTS; i++)
+        if (hot_size[i] == asize)
+            return i;
+    return -1;
+}
+
+/*
+ * hot_push - asize가 hot이고 quick list에 자리가 있으면 bp를 넣고 1
+ * 블록 헤더는 읽지 않으므로 실제 블록이 asize보다 커도 된다 (flush할 때 헤더로 병합)
+ */
+static int hot_push(size_t asize, void *bp)
+{
+    int slot = hot_slot(asize);
+
+    if (slot < 0 || (size_t)hot_len[slot] >= params.hot_list_max)
+        return 0;
+    QL_NEXT(bp) = hot_list[slot];
+    hot_list[slot] = bp;
+    hot_len[slot]++;
+    CHECK_TOUCH(bp);
+    STAT_INC(quick_pushes);
+    return 1;
+}
+
+/*
+ * hot_record - 할당 요청 하나를 기록하고 asize의 hot slot 반환 (hot이 아니면 -1)
+ * sketch 추정치가 hot_min_count 이상이고 가장 차가운 slot보다 크면 그 slot을 빼앗는다.
+ */
+static int hot_record(size_t asize)
+{
+    unsigned int est;
+    int slot, victim;
+
+    if (++hot_clock >= params.hot_window)
+        hot_decay();
+
+    if ((slot = hot_slot(asize)) >= 0) {
+        hot_count[slot]++;
+        return slot;
+    }
+
+    if ((est = sketch_add(asize)) < params.hot_min_count)
+        return -1;
+
+    victim = 0;
+    for (int i = 1; i < HOT_SLOTS; i++)
+        if (hot_count[i] < hot_count[victim])
+            victim = i;
+    if (hot_size[victim] != 0 && hot_count[victim] >= est)
+        return -1;
+
+    hot_flush(victim);
+    hot_size[victim] = asize;
+    hot_count[victim] = est;
+    return victim;
+}
+
+/*
+ * sketch_add - count-min sketch에 asize를 1 더하고 추정 횟수 반환
+ */
+static unsigned int sketch_add(size_t asize)
+{
+    unsigned int key = (unsigned int)(asize / DSIZE);
+    unsigned int h[SKETCH_DEPTH] = {
+        (key * 0x9E3779B1u) >> 24,
+        (key * 0x85EBCA77u) >> 24
+    };
+    unsigned int est = UINT_MAX;
+
+    for (int d = 0; d < SKETCH_DEPTH; d++) {
+        unsigned short *c = &sketch[d][h[d] % SKETCH_WIDTH];
+        if (*c < USHRT_MAX)
+            (*c)++;
+        if (*c < est)
+            est = *c;
+    }
+    return est;
+}
+
+/*
+ * hot_decay - 모든 카운터를 절반으로 줄이고 식은 크기의 quick list를 비운다
+ */
+static void hot_decay(void)
+{
+    hot_clock = 0;
+
+    for (int d = 0; d < SKETCH_DEPTH; d++)
+        for (int i = 0; i < SKETCH_WIDTH; i++)
+            sketch[d][i] >>= 1;
+
+    for (int i = 0; i < HOT_SLOTS; i++) {
+        hot_count[i] >>= 1;
+        if (hot_size[i] != 0 && hot_count[i] < params.hot_cold_count) {
+            hot_flush(i);
+            hot_size[i] = 0;
+        }
+    }
+}
+
+/*
+ * hot_flush - slot의 quick list 블록을 모두 실제로 free (병합 포함)
+ */
+static void hot_flush(int slot)
+{
+    void *bp = hot_list[slot];
+
+    while (bp != NULL) {
+        void *next = QL_NEXT(bp);
+        free_block(bp);
+        bp = next;
+    }
+    hot_list[slot] = NULL;
+    hot_len[slot] = 0;
+}
+
+/*
+ * hot_consolidate - 모든 quick list와 고정 크기 bin을 비운다 (hot 크기는 유지)
+ * 비운 블록이 있었으면 1
+ */
+static int hot_consolidate(void)
+{
+    int flushed = 0;
+
+    for (int i = 0; i < HOT_SLOTS; i++)
+        if (hot_list[i] != NULL) {
+            hot_flush(i);
+            flushed = 1;
+        }
+#ifndef THREAD_CACHE
+    if (fixed_flush())
+        flushed = 1;
+#endif
+#ifdef DEFER_COALESCE
+    if (defer_drain(INT_MAX) > 0)
+        flushed = 1;
+#endif
+    if (flushed)
+        STAT_INC(quick_consolidations);
+    return flushed;
+}
+
+#ifdef INDEX_TREE
+/*
+ * ========== Free-block index (splay tree) Helper 함수들 ==========
+ */
+
+/*
+ * tree_cmp - (size, addr) 키와 node의 키를 비교
+ * 크기가 같으면 주소 순으로 정렬하여 address-ordered 배치를 유지
+ */
+static int tree_cmp(size_t size, void *addr, void *node)
+{
+    size_t node_size = GET_SIZE(HDRP(node));
+
+    if (size != node_size)
+        return (size < node_size) ? -1 : 1;
+    if (addr != node)
+        return ((char *)addr < (char *)node) ? -1 : 1;
+    return 0;
+}
+
+/*
+ * tree_splay - top-down splay: (size, addr)에 가장 가까운 노드를 루트로 올림
+ * 키가 없으면 루트는 키의 직전 또는 직후 노드가 됨
+ */
+static void *tree_splay(void *root, size_t size, void *addr)
+{
+    void *l_root = NULL, *l_max = NULL;   /* 키보다 작은 노드들 */
+    void *r_root = NULL, *r_min = NULL;   /* 키보다 큰 노드들 */
+    void *t = root;
+    void *y;
+
+    if (t == NULL)
+        return NULL;
+
+    for (;;) {
+        int c = tree_cmp(size, addr, t);
+        STAT_STEP();
+        if (c < 0) {
+            if ((y = GET_LEFT(t)) == NULL)
+                break;
+            if (tree_cmp(size, addr, y) < 0) {
+                /* 오른쪽 회전 */
+                SET_LEFT(t, GET_RIGHT(y));
+                SET_RIGHT(y, t);
+                t = y;
+                if (GET_LEFT(t) == NULL)
+                    break;
+            }
+            /* t를 오른쪽 트리에 연결 */
+            if (r_min != NULL)
+                SET_LEFT(r_min, t);
+            else
+                r_root = t;
+            r_min = t;
+            t = GET_LEFT(t);
+        } else if (c > 0) {
+            if ((y = GET_RIGHT(t)) == NULL)
+                break;
+            if (tree_cmp(size, addr, y) > 0) {
+                /* 왼쪽 회전 */
+                SET_RIGHT(t, GET_LEFT(y));
+                SET_LEFT(y, t);
+                t = y;
+                if (GET_RIGHT(t) == NULL)
+                    break;
+            }
+            /* t를 왼쪽 트리에 연결 */
+            if (l_max != NULL)
+                SET_RIGHT(l_max, t);
+            else
+                l_root = t;
+            l_max = t;
+            t = GET_RIGHT(t);
+        } else {
+            break;
+        }
+    }
+
+    /* 재조립 */
+    if (l_max != NULL) {
+        SET_RIGHT(l_max, GET_LEFT(t));
+        SET_LEFT(t, l_root);
+    }
+    if (r_min != NULL) {
+        SET_LEFT(r_min, GET_RIGHT(t));
+        SET_RIGHT(t, r_root);
+    }
+    return t;
+}
+
+/*
+ * tree_lower_bound - index 트리에서 크기가 asize 이상인 가장 작은 (size, addr) 블록
+ */
+static void *tree_lower_bound(int index, size_t asize)
+{
+    /* 주소 NULL은 모든 블록보다 작으므로 (asize, NULL)은 트리에 없는 키 */
+    void *root = tree_splay(seg_list[index], asize, NULL);
+    seg_list[index] = root;
+
+    if (GET_SIZE(HDRP(root)) >= asize)
+        return root;
+
+    /* 루트가 키의 직전 노드이면 답은 오른쪽 서브트리의 최소 노드 */
+    void *bp = GET_RIGHT(root);
+    if (bp == NULL)
+        return NULL;
+    while (GET_LEFT(bp) != NULL) {
+        STAT_STEP();
+        bp = GET_LEFT(bp);
+    }
+    return bp;
+}
+#endif
+
+#ifdef THREAD_CACHE
+/*
+ * ========== Thread cache Helper 함수들 ==========
+ */
+
+/*
+ * tcache_get - 현재 스레드의 cache 반환, 처음 호출이면 빈 slot을 할당
+ * slot이 모두 사용 중이면 NULL (호출자는 공유 힙을 직접 사용)
+ */
+static tcache_t *tcache_get(void)
+{
+    if (my_tcache != NULL)
+        return my_tcache;
+
+    pthread_once(&tcache_key_once, tcache_make_key);
+
+    HEAP_LOCK();
+    for (int i = 1; i <= TCACHE_MAX_THREADS; i++) {
+        tcache_t *tc = &tcaches[i];
+        if (atomic_load(&tc->live))
+            continue;
+
+        /* 이전 소유 스레드가 종료된 뒤 도착한 remote free는 공유 힙에 반환 */
+        void *bp = atomic_exchange(&tc->remote, NULL);
+        while (bp != NULL) {
+            void *next = TC_NEXT(bp);
+            heap_free(bp);
+            bp = next;
+        }
+        tc->id = i;
+        atomic_store(&tc->live, 1);
+        my_tcache = tc;
+        break;
+    }
+    HEAP_DONE();
+
+    if (my_tcache != NULL)
+        pthread_setspecific(tcache_key, my_tcache);
+    return my_tcache;
+}
+
+/*
+ * tcache_make_key - 스레드 종료 시 tcache_detach를 호출하는 key 생성
+ */
+static void tcache_make_key(void)
+{
+    pthread_key_create(&tcache_key, tcache_detach);
+}
+
+/*
+ * tcache_detach - 종료하는 스레드의 cache를 공유 힙에 모두 반환하고 slot 해제
+ */
+static void tcache_detach(void *arg)
+{
+    tcache_t *tc = arg;
+
+    HEAP_LOCK();
+    for (int i = 0; i < TCACHE_BINS; i++) {
+        void *bp = tc->bins[i];
+        while (bp != NULL) {
+            void *next = TC_NEXT(bp);
+            heap_free(bp);
+            bp = next;
+        }
+        tc->bins[i] = NULL;
+        tc->counts[i] = 0;
+    }
+    atomic_store(&tc->live, 0);
+
+    /* live를 내린 뒤에도 진행 중이던 push가 남을 수 있음: 다음 소유자가 tcache_get에서 정리 */
+    void *bp = atomic_exchange(&tc->remote, NULL);
+    while (bp != NULL) {
+        void *next = TC_NEXT(bp);
+        heap_free(bp);
+        bp = next;
+    }
+    HEAP_DONE();
+    my_tcache = NULL;
+}
+
+/*
+ * tcache_reset_all - 모든 cache와 소유자 힌트 초기화 (mm_init에서 힙을 새로 만들 때)
+ */
+static void tcache_reset_all(void)
+{
+    for (int i = 0; i <= TCACHE_MAX_THREADS; i++) {
+        memset(tcaches[i].bins, 0, sizeof(tcaches[i].bins));
+        memset(tcaches[i].counts, 0, sizeof(tcaches[i].counts));
+        atomic_store(&tcaches[i].remote, NULL);
+    }
+    for (int i = 0; i < OWNER_SLOTS; i++)
+        atomic_store_explicit(&page_owner[i], 0, memory_order_relaxed);
+}
+
+/*
+ * tcache_malloc - bin에서 asize 블록을 꺼냄
+ * bin이 비면 remote free를 먼저 모으고, 그래도 없으면 공유 힙에서 TCACHE_BATCH개를 가져옴
+ */
+static void *tcache_malloc(size_t asize)
+{
+    tcache_t *tc = tcache_get();
+    int bin = asize / DSIZE;
+    void *bp;
 
-    size_t size = GET_SIZE(HDRP(bp));
-    int index = get_seg_index(size);
+    if (tc == NULL) {
+        HEAP_LOCK();
+        bp = heap_alloc(asize);
+        HEAP_DONE();
+        return bp;
+    }
 
-    void *pred = GET_PRED(bp);
-    void *succ = GET_SUCC(bp);
+    if (tc->bins[bin] == NULL)
+        tcache_collect_remote(tc);
+
+    if (tc->bins[bin] == NULL) {
+        HEAP_LOCK();
+        for (int i = 0; i < TCACHE_BATCH; i++) {
+            if ((bp = heap_alloc(asize)) == NULL)
+                break;
+            TC_NEXT(bp) = tc->bins[bin];
+            tc->bins[bin] = bp;
+            tc->counts[bin]++;
+            atomic_store_explicit(&page_owner[OWNER_SLOT(bp)], tc->id, memory_order_relaxed);
+        }
+        HEAP_DONE();
+        if (tc->bins[bin] == NULL)
+            return NULL;
+    }
 
-    if (pred == NULL) {
-        seg_list[index] = succ;
-    } else {
-        SET_SUCC(pred, succ);
+    bp = tc->bins[bin];
+    tc->bins[bin] = TC_NEXT(bp);
+    tc->counts[bin]--;
+    return bp;
+}
+
+/*
+ * tcache_free - 작은 블록 해제
+ * 다른 살아 있는 스레드 소유의 블록이면 그 cache의 remote queue에 lock 없이 push
+ */
+static void tcache_free(void *bp, size_t asize)
+{
+    tcache_t *tc = tcache_get();
+    int owner = atomic_load_explicit(&page_owner[OWNER_SLOT(bp)], memory_order_relaxed);
+
+    if (tc == NULL) {
+        HEAP_LOCK();
+        heap_free(bp);
+        HEAP_DONE();
+        return;
     }
 
-    if (succ != NULL) {
-        SET_PRED(succ, pred);
+    if (owner != 0 && owner != tc->id && atomic_load(&tcaches[owner].live)) {
+        tcache_t *dst = &tcaches[owner];
+        void *head = atomic_load_explicit(&dst->remote, memory_order_relaxed);
+        do {
+            TC_NEXT(bp) = head;
+        } while (!atomic_compare_exchange_weak_explicit(&dst->remote, &head, bp,
+                                                        memory_order_release,
+                                                        memory_order_relaxed));
+        return;
     }
+
+    tcache_push(tc, bp, asize);
 }
 
 /*
- * ========== Binary Trace 최적화 Helper 함수들 ==========
+ * tcache_push - 블록을 asize의 bin에 넣고, bin이 가득 차면 TCACHE_BATCH개를 공유 힙에 반환
  */
+static void tcache_push(tcache_t *tc, void *bp, size_t asize)
+{
+    int bin = asize / DSIZE;
+
+    TC_NEXT(bp) = tc->bins[bin];
+    tc->bins[bin] = bp;
+
+    if (++tc->counts[bin] > TCACHE_BIN_MAX) {
+        HEAP_LOCK();
+        for (int i = 0; i < TCACHE_BATCH; i++) {
+            void *victim = tc->bins[bin];
+            tc->bins[bin] = TC_NEXT(victim);
+            heap_free(victim);
+        }
+        HEAP_DONE();
+        tc->counts[bin] -= TCACHE_BATCH;
+    }
+}
 
 /*
- * detect_binary_pattern - binary trace 패턴 감지
- * 80B, 128B, 464B 크기가 자주 할당되면 binary_mode 활성화
+ * tcache_collect_remote - remote queue 전체를 한 번에 가져와 bin에 재분배
  */
-static void detect_binary_pattern(size_t asize)
+static void tcache_collect_remote(tcache_t *tc)
 {
-    alloc_count++;
+    void *bp;
 
-    /* 이미 binary mode이면 카운팅만 */
-    if (binary_mode) {
-        int idx = get_exact_fit_index(asize);
-        if (idx >= 0) {
-            exact_fit_count[idx]++;
-        }
+    if (atomic_load_explicit(&tc->remote, memory_order_relaxed) == NULL)
         return;
+
+    bp = atomic_exchange_explicit(&tc->remote, NULL, memory_order_acquire);
+    while (bp != NULL) {
+        void *next = TC_NEXT(bp);
+        tcache_push(tc, bp, GET_SIZE(HDRP(bp)));
+        bp = next;
     }
+}
+#endif
+
+#ifdef SLAB_TIER
+/*
+ * ========== Slab tier Helper 함수들 ==========
+ */
+
+/*
+ * slab_init - 새 slab side region 예약, 모든 run 리스트 비우기
+ * mm_init 직전의 mem_reset_brk가 이전 side region을 이미 해제했다.
+ */
+static void slab_init(void)
+{
+    slab_base = mem_region_reserve(SLAB_RESERVE);
+    slab_used = 0;
+    slab_empty = NULL;
+    for (int i = 0; i < SLAB_CLASSES; i++)
+        slab_partial[i] = NULL;
+}
+
+/*
+ * slab_alloc - size 바이트 slot 하나 할당, run을 만들 수 없으면 NULL
+ */
+static void *slab_alloc(size_t size)
+{
+    int cls = SLAB_CLASS(size);
+    slab_run_t *run = slab_partial[cls];
+    int w, bit;
+
+    if (run == NULL && (run = slab_new_run(cls)) == NULL)
+        return NULL;
+
+    /* 첫 번째 빈 slot */
+    for (w = 0; run->bitmap[w] == 0; w++)
+        ;
+    bit = __builtin_ctzll(run->bitmap[w]);
+    run->bitmap[w] &= run->bitmap[w] - 1;
 
-    /* 특정 크기 할당 감지 */
-    int idx = get_exact_fit_index(asize);
-    if (idx >= 0) {
-        exact_fit_count[idx]++;
+    /* 가득 찬 run은 partial 리스트에서 뺀다 */
+    if (--run->nfree == 0)
+        slab_unlink(run);
+
+    return (char *)run + SLAB_HDR_SIZE + (size_t)(w * 64 + bit) * run->slot_size;
+}
+
+/*
+ * slab_free - slot 반환
+ * 가득 찼던 run은 partial 리스트로 돌아가고, 완전히 빈 run은 그 class의
+ * 유일한 run이 아니면 빈 run 리스트로 옮겨 다른 class가 재사용할 수 있게 한다.
+ */
+static void slab_free(void *p)
+{
+    slab_run_t *run = RUN_OF(p);
+    uint64_t off = (uint64_t)((char *)p - (char *)run - SLAB_HDR_SIZE);
+    unsigned int idx = (unsigned int)((off * run->recip) >> 32);
+
+    run->bitmap[idx / 64] |= (uint64_t)1 << (idx % 64);
+
+    if (run->nfree++ == 0) {
+        run->prev = NULL;
+        run->next = slab_partial[run->cls];
+        if (run->next != NULL)
+            run->next->prev = run;
+        slab_partial[run->cls] = run;
+        return;
     }
 
-    /* 일정 횟수 이상 특정 크기가 할당되면 binary mode 활성화 */
-    if (alloc_count >= 50) {
-        if (exact_fit_count[0] >= 10 || exact_fit_count[1] >= 10 || exact_fit_count[2] >= 10) {
-            binary_mode = 1;
-        }
+    if (run->nfree == run->nslots && (run->prev != NULL || run->next != NULL)) {
+        slab_unlink(run);
+        run->next = slab_empty;
+        slab_empty = run;
     }
 }
 
 /*
- * get_exact_fit_index - 크기가 exact fit 리스트에 해당하는지 확인
- * 반환: 0(80B), 1(128B), 2(464B), -1(해당없음)
+ * slab_realloc - 같은 class면 그대로, 아니면 새로 할당해 복사
  */
-static int get_exact_fit_index(size_t size)
+static void *slab_realloc(void *p, size_t size)
 {
-    if (size == SIZE_80) return 0;
-    if (size == SIZE_128) return 1;
-    if (size == SIZE_464) return 2;
-    return -1;
+    size_t old_size;
+    void *newp;
+
+    HEAP_LOCK();
+    old_size = RUN_OF(p)->slot_size;
+    HEAP_DONE();
+
+    if (size <= SLAB_MAX_SIZE && SLAB_CLASS(size) == SLAB_CLASS(old_size))
+        return p;
+
+    if ((newp = mm_malloc(size)) == NULL)
+        return NULL;
+    memcpy(newp, p, MIN(size, old_size));
+    mm_free(p);
+    return newp;
 }
 
 /*
- * add_to_exact_list - exact fit 전용 리스트에 블록 추가 (LIFO)
+ * slab_new_run - cls용 run을 빈 run 리스트나 side region에서 가져와 초기화하고
+ * partial 리스트에 넣는다
  */
-static void add_to_exact_list(void *bp, int index)
+static slab_run_t *slab_new_run(int cls)
 {
-    if (bp == NULL || index < 0 || index >= EXACT_FIT_CLASSES)
-        return;
+    slab_run_t *run;
+    int i;
 
-    SET_PRED(bp, NULL);
-    SET_SUCC(bp, exact_fit_lists[index]);
+    if (slab_empty != NULL) {
+        run = slab_empty;
+        slab_empty = run->next;
+    } else {
+        if (slab_base == NULL || (long)mem_region_sbrk(slab_base, RUN_SIZE) == -1)
+            return NULL;
+        run = (slab_run_t *)(slab_base + slab_used);
+        slab_used += RUN_SIZE;
+    }
 
-    if (exact_fit_lists[index] != NULL) {
-        SET_PRED(exact_fit_lists[index], bp);
+    run->slot_size = (cls + 1) * ALIGN_SIZE;
+    run->recip = (unsigned int)((((uint64_t)1 << 32) + run->slot_size - 1) / run->slot_size);
+    run->nslots = (RUN_SIZE - SLAB_HDR_SIZE) / run->slot_size;
+    run->nfree = run->nslots;
+    run->cls = cls;
+    for (i = 0; i < SLAB_BITMAP_WORDS; i++) {
+        int left = run->nslots - i * 64;
+        run->bitmap[i] = left >= 64 ? ~(uint64_t)0 : left > 0 ? ((uint64_t)1 << left) - 1 : 0;
     }
 
-    exact_fit_lists[index] = bp;
+    run->prev = NULL;
+    run->next = slab_partial[cls];
+    if (run->next != NULL)
+        run->next->prev = run;
+    slab_partial[cls] = run;
+    return run;
+}
+
+/*
+ * slab_unlink - run을 자기 class의 partial 리스트에서 제거
+ */
+static void slab_unlink(slab_run_t *run)
+{
+    if (run->prev != NULL)
+        run->prev->next = run->next;
+    else
+        slab_partial[run->cls] = run->next;
+    if (run->next != NULL)
+        run->next->prev = run->prev;
+    run->prev = run->next = NULL;
 }
+#endif
+
+#ifdef LARGE_TIER
+/*
+ * ========== Large tier Helper 함수들 ==========
+ * 호출자가 HEAP_LOCK을 잡고 있어야 하는 함수: large_alloc, large_free
+ */
 
 /*
- * get_from_exact_list - exact fit 리스트에서 블록 가져오기
+ * large_alloc - size 바이트 payload용 mapping 생성, 실패하면 NULL
  */
-static void *get_from_exact_list(size_t asize)
+static void *large_alloc(size_t size)
 {
-    int idx = get_exact_fit_index(asize);
-    if (idx < 0)
+    size_t len = LARGE_MAP_LEN(size);
+    char *base;
+    char *bp;
+
+    if ((long)(base = mem_map(len)) == -1)
         return NULL;
 
-    void *bp = exact_fit_lists[idx];
-    if (bp == NULL)
+    bp = base + LARGE_HDR_SIZE;
+    LARGE_LEN(bp) = len;
+    PUT(HDRP(bp), LARGE_BIT | 0x1);
+    return bp;
+}
+
+/*
+ * large_free - mapping을 바로 unmap
+ */
+static void large_free(void *bp)
+{
+    mem_unmap((char *)bp - LARGE_HDR_SIZE);
+}
+
+/*
+ * large_realloc - 여전히 큰 크기면 mremap으로 복사 없이 늘리거나 줄이고,
+ * LARGE_THRESHOLD 이하로 줄어들면 일반 힙으로 한 번 복사
+ */
+static void *large_realloc(void *bp, size_t size)
+{
+    size_t len = LARGE_MAP_LEN(size);
+    char *base;
+    void *newp;
+
+    if (size > LARGE_THRESHOLD) {
+        /* 같은 페이지 수면 할 일이 없음 */
+        if (len == LARGE_LEN(bp))
+            return bp;
+
+        HEAP_LOCK();
+        base = mem_remap((char *)bp - LARGE_HDR_SIZE, len);
+        HEAP_DONE();
+        if ((long)base == -1)
+            return NULL;
+
+        bp = base + LARGE_HDR_SIZE;
+        LARGE_LEN(bp) = len;
+        return bp;
+    }
+
+    if ((newp = mm_malloc(size)) == NULL)
+        return NULL;
+    memcpy(newp, bp, size);
+    mm_free(bp);
+    return newp;
+}
+
+/*
+ * large_from_heap - 일반 힙 블록이 LARGE_THRESHOLD를 넘게 커질 때 mapping으로 옮김
+ * mapping을 만들 수 없으면 NULL (호출자는 일반 힙 realloc으로 진행)
+ */
+static void *large_from_heap(void *ptr, size_t size)
+{
+    size_t old_size = GET_SIZE(HDRP(ptr)) - WSIZE;
+    void *newp;
+
+    HEAP_LOCK();
+    newp = large_alloc(size);
+    HEAP_DONE();
+    if (newp == NULL)
         return NULL;
 
-    /* 리스트에서 제거 */
-    void *succ = GET_SUCC(bp);
-    exact_fit_lists[idx] = succ;
-    if (succ != NULL) {
-        SET_PRED(succ, NULL);
+    memcpy(newp, ptr, MIN(size, old_size));
+    mm_free(ptr);
+    return newp;
+}
+#endif
+
+#ifdef MM_STATS
+/*
+ * ========== Statistics Helper 함수들 ==========
+ */
+
+/*
+ * stat_walk - 방금 끝난 탐색의 길이(walk)를 합계와 log2 히스토그램에 더함
+ */
+static void stat_walk(unsigned long *hist, unsigned long *total)
+{
+    int bucket = (walk == 0) ? 0 : (int)(8 * sizeof(walk)) - __builtin_clzl(walk);
+
+    *total += walk;
+    hist[MIN(bucket, MM_STATS_WALK_BUCKETS - 1)]++;
+}
+#endif
+
+/*
+ * ========== Batch API Helper 함수들 ==========
+ * 호출자가 HEAP_LOCK을 잡고 있어야 하는 함수: carve_batch
+ */
+
+/*
+ * carve_batch - free 블록 bp의 앞에서 asize 블록 n개를 잘라 ptrs에 채움
+ * 남은 부분은 MIN_BLOCK_SIZE 이상이면 free 블록으로, 아니면 마지막 블록에 붙임
+ */
+static void carve_batch(void *bp, size_t asize, size_t n, void **ptrs)
+{
+    size_t rest = GET_SIZE(HDRP(bp)) - asize * n;
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+    char *p = bp;
+
+    remove_from_free_list(bp);
+    for (size_t i = 0; i < n; i++) {
+        size_t bsize = (i == n - 1 && rest < MIN_BLOCK_SIZE) ? asize + rest : asize;
+        PUT(HDRP(p), PACK(bsize, 1, prev_alloc));
+        ptrs[i] = p;
+        CHECK_TOUCH(p);
+        prev_alloc = 1;
+        p = NEXT_BLKP(p);
     }
 
-    return bp;
+    if (rest >= MIN_BLOCK_SIZE) {
+        /* 원래 블록이 free였으므로 다음 블록의 prev_alloc은 이미 0 */
+        PUT(HDRP(p), PACK(rest, 0, 1));
+        PUT(FTRP(p), PACK(rest, 0, 1));
+        add_to_free_list(p);
+    } else {
+        SET_PREV_ALLOC(HDRP(p));
+    }
 }
 
 /*
- * remove_from_exact_list - exact fit 리스트에서 블록 제거
+ * ptr_cmp - qsort용 주소 비교
  */
-static void remove_from_exact_list(void *bp, int index)
+static int ptr_cmp(const void *a, const void *b)
 {
-    if (bp == NULL || index < 0 || index >= EXACT_FIT_CLASSES)
-        return;
+    char *x = *(char *const *)a;
+    char *y = *(char *const *)b;
 
-    void *pred = GET_PRED(bp);
-    void *succ = GET_SUCC(bp);
+    return (x > y) - (x < y);
+}
 
-    if (pred == NULL) {
-        exact_fit_lists[index] = succ;
+#ifndef THREAD_CACHE
+/*
+ * ========== Fixed-size bin Helper 함수들 ==========
+ * 호출자가 HEAP_LOCK을 잡고 있어야 함
+ */
+
+/*
+ * fixed_release - bin의 앞에서 블록을 n개까지 꺼내 공유 힙에 반환
+ */
+static void fixed_release(int bin, int n)
+{
+    for (int i = 0; i < n && mm_fixed_bin[bin] != NULL; i++) {
+        void *bp = mm_fixed_bin[bin];
+        mm_fixed_bin[bin] = QL_NEXT(bp);
+        mm_fixed_len[bin]--;
+        mm_fixed_bytes -= (size_t)bin * DSIZE;
+        heap_free(bp);
+    }
+}
+
+/*
+ * fixed_flush - 모든 bin을 비워 블록을 병합과 함께 free index에 넣는다
+ * 비운 블록이 있었으면 1
+ */
+static int fixed_flush(void)
+{
+    int flushed = 0;
+
+    for (int i = 0; i < MM_FIXED_BINS; i++) {
+        void *bp = mm_fixed_bin[i];
+        while (bp != NULL) {
+            void *next = QL_NEXT(bp);
+            free_block(bp);
+            bp = next;
+            flushed = 1;
+        }
+        mm_fixed_bin[i] = NULL;
+        mm_fixed_len[i] = 0;
+    }
+    mm_fixed_bytes = 0;
+    return flushed;
+}
+#endif
+
+#ifdef DEFER_COALESCE
+/*
+ * ========== Deferred Coalescing Helper 함수들 ==========
+ * 호출자가 HEAP_LOCK을 잡고 있어야 함
+ */
+
+/*
+ * defer_take - asize class의 unsorted 리스트 앞쪽 DEFER_SCAN개 중 asize 이상인 블록을 꺼냄
+ * 블록은 할당 표시 그대로라 place처럼 남는 뒤쪽이 split_min 이상일 때만 잘라서,
+ * 잘라낸 조각은 다시 병합을 미루는 리스트로 보낸다
+ */
+static void *defer_take(size_t asize)
+{
+    void **link = &defer_list[get_seg_index(asize)];
+
+    for (int n = 0; *link != NULL && n < DEFER_SCAN; n++) {
+        void *bp = *link;
+        size_t size = GET_SIZE(HDRP(bp));
+        if (size >= asize) {
+            *link = QL_NEXT(bp);
+            defer_count--;
+            STAT_INC(deferred_hits);
+            if (size - asize >= params.split_min) {
+                void *rest;
+
+                PUT(HDRP(bp), PACK(asize, 1, GET_PREV_ALLOC(HDRP(bp))));
+                rest = NEXT_BLKP(bp);
+                PUT(HDRP(rest), PACK(size - asize, 1, 1));
+                defer_free(rest);
+            }
+            CHECK_TOUCH(bp);
+            return bp;
+        }
+        link = &QL_NEXT(bp);
+    }
+    return NULL;
+}
+
+/*
+ * defer_drain - 미뤄 둔 블록을 최대 budget개 병합해 free list로, 병합한 개수 반환
+ * defer_cursor부터 class를 돌아가며 비워서 batch마다 같은 class만 비우지 않게 한다.
+ */
+static int defer_drain(int budget)
+{
+    int drained = 0;
+
+    while (drained < budget && defer_count > 0) {
+        while (defer_list[defer_cursor] == NULL)
+            defer_cursor = (defer_cursor + 1) % SEG_LIST_COUNT;
+        void *bp = defer_list[defer_cursor];
+        defer_list[defer_cursor] = QL_NEXT(bp);
+        defer_count--;
+        free_block(bp);
+        drained++;
+    }
+    STAT_ADD(deferred_drained, drained);
+    return drained;
+}
+#endif
+
+#ifdef MM_CHECK
+/*
+ * ========== Heap Checker Helper 함수들 ==========
+ * 호출자가 HEAP_LOCK을 잡고 있어야 함
+ */
+
+/*
+ * check_op - 공유 힙 연산 하나가 끝날 때 check_mode에 따라 검사 (HEAP_DONE)
+ * 문제가 있으면 손상된 지점에서 멀어지기 전에 abort
+ */
+static void check_op(void)
+{
+    int touched = check_touched;
+
+    check_touched = 0;
+    check_ops++;
+    if (check_mode == MM_CHECK_OFF || heap_listp == NULL)
+        return;
+
+    if (check_mode == MM_CHECK_FULL ||
+        (check_mode == MM_CHECK_SAMPLE && check_ops % check_every == 0) ||
+        (check_mode == MM_CHECK_INCR && touched > CHECK_RING)) {
+        check_heap();
+    } else if (check_mode == MM_CHECK_INCR) {
+        check_problems = 0;
+        for (int i = 0; i < touched; i++)
+            check_block(check_ring[i]);
     } else {
-        SET_SUCC(pred, succ);
+        return;
     }
 
-    if (succ != NULL) {
-        SET_PRED(succ, pred);
+    if (check_problems > 0) {
+        fprintf(stderr, "mm_check: %d problem(s) after heap operation %lu\n",
+                check_problems, check_ops);
+        abort();
+    }
+}
+
+/*
+ * check_untouch - bp를 check_ring에서 지움 (free list에서 빠져 할당되거나 병합될 블록)
+ */
+static void check_untouch(void *bp)
+{
+    if (check_touched > CHECK_RING)
+        return;
+    for (int i = 0; i < check_touched; ) {
+        if (check_ring[i] == bp)
+            check_ring[i] = check_ring[--check_touched];
+        else
+            i++;
+    }
+}
+
+/*
+ * check_heap - 힙 전체 검사, 문제 수 반환
+ * 모든 블록을 check_block으로 보고 free 블록 수를 센 뒤, free index를 따라가며
+ * 노드가 자기 class의 free 블록인지, 노드 수가 힙의 free 블록 수와 같은지 확인
+ */
+static int check_heap(void)
+{
+    size_t nfree = 0, nindexed = 0;
+
+    check_problems = 0;
+    if (heap_listp == NULL)
+        return 0;
+
+    for (int r = 0; r < num_heap_regions; r++) {
+        char *bp = heap_regions[r];
+
+        if (GET(HDRP(bp - DSIZE)) != PACK(DSIZE, 1, 1))
+            check_report(bp - DSIZE, "bad prologue");
+        for (; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+            if (check_block(bp) < 0)
+                break;
+            if (!GET_ALLOC(HDRP(bp)))
+                nfree++;
+        }
+        if (GET_SIZE(HDRP(bp)) == 0 && !GET_ALLOC(HDRP(bp)))
+            check_report(bp, "bad epilogue");
+    }
+
+    for (int i = 0; i < SEG_LIST_COUNT; i++) {
+        int marked = (sl_bitmap[i / SL_COUNT] >> (i % SL_COUNT)) & 1;
+        if (marked != (seg_list[i] != NULL))
+            check_report(seg_list[i], "class bitmap disagrees with the class");
+#ifdef INDEX_TREE
+        nindexed += check_tree(seg_list[i], i, NULL, NULL, nfree + 1 - nindexed);
+#else
+        /* 노드 수가 nfree를 넘으면 (순환) 멈춘다 */
+        for (void *bp = seg_list[i]; bp != NULL && nindexed <= nfree; bp = GET_SUCC(bp)) {
+            if (!check_node(bp, i)) {
+                check_report(bp, "free list node is not a free block of its class");
+                break;
+            }
+            nindexed++;
+        }
+#endif
+    }
+    for (int f = 0; f < FL_COUNT; f++)
+        if (((fl_bitmap >> f) & 1) != (sl_bitmap[f] != 0))
+            check_report(NULL, "first-level bitmap disagrees with the second level");
+    if (nindexed != nfree)
+        check_report(NULL, "free index and block chain disagree on the free block count");
+
+    return check_problems;
+}
+
+/*
+ * check_block - 블록 하나와 그 양옆 검사
+ * 블록 체인을 이 블록 너머로 따라갈 수 없으면 (크기가 깨졌거나 힙 밖) -1
+ */
+static int check_block(void *bp)
+{
+    unsigned int hdr = GET(HDRP(bp));
+    size_t size = GET_SIZE(HDRP(bp));
+    char *next_bp;
+
+    if ((uintptr_t)bp % ALIGN_SIZE != 0) {
+        check_report(bp, "payload is not aligned");
+        return -1;
+    }
+    if (size < MIN_BLOCK_SIZE || size % ALIGN_SIZE != 0) {
+        check_report(bp, "bad block size");
+        return -1;
+    }
+    next_bp = NEXT_BLKP(bp);
+    if (!mem_in_heap(HDRP(bp), HDRP(next_bp) + WSIZE - 1)) {
+        check_report(bp, "block runs past the end of its region");
+        return -1;
     }
+    if (hdr & 0x4)
+        check_report(bp, "stray bit 2 in the header");
+    if (GET_PREV_ALLOC(HDRP(next_bp)) != (hdr & 0x1))
+        check_report(bp, "next block's prev_alloc bit is wrong");
+
+    if (hdr & 0x1) {
+        /* prev_alloc이 0이면 바로 앞은 풋터로 찾을 수 있는 free 블록이어야 한다 */
+        if (!GET_PREV_ALLOC(HDRP(bp))) {
+            char *ftr = (char *)bp - DSIZE;
+            size_t psize = GET_SIZE(ftr);
+            if (GET_ALLOC(ftr) || psize < MIN_BLOCK_SIZE ||
+                !mem_in_heap((char *)bp - psize - WSIZE, ftr) ||
+                GET_SIZE(HDRP(bp) - psize) != psize)
+                check_report(bp, "prev_alloc is clear but no free block precedes it");
+        }
+        return 0;
+    }
+
+    if ((GET(FTRP(bp)) & ~0x2) != (hdr & ~0x2))
+        check_report(bp, "footer does not match header");
+    if (!GET_PREV_ALLOC(HDRP(bp)) || !GET_ALLOC(HDRP(next_bp)))
+        check_report(bp, "two adjacent free blocks");
+#ifdef SCAN_PREFETCH
+    if (GET_FSIZE(bp) != size)
+        check_report(bp, "stale size copy next to the links");
+#endif
+    check_index(bp, get_seg_index(size));
+    return 0;
+}
+
+/*
+ * check_index - free 블록 bp가 class index의 bitmap, 리스트(트리)에 제대로 들어 있는지
+ */
+static void check_index(void *bp, int index)
+{
+    if (!((sl_bitmap[index / SL_COUNT] >> (index % SL_COUNT)) & 1) ||
+        !((fl_bitmap >> (index / SL_COUNT)) & 1))
+        check_report(bp, "class bitmap bit is clear");
+
+#ifdef INDEX_TREE
+    /* splay하지 않고 루트에서 키로 내려가 bp를 찾는다 */
+    size_t size = GET_SIZE(HDRP(bp));
+    void *node = seg_list[index];
+    void *left = GET_LEFT(bp), *right = GET_RIGHT(bp);
+    size_t steps = mem_heapsize() / MIN_BLOCK_SIZE;
+
+    while (node != NULL && node != bp && steps-- > 0) {
+        if (!check_node(node, index))
+            break;
+        node = (tree_cmp(size, bp, node) < 0) ? GET_LEFT(node) : GET_RIGHT(node);
+    }
+    if (node != bp)
+        check_report(bp, "free block is not in its class tree");
+    if ((left != NULL && (!check_node(left, index) ||
+                          tree_cmp(GET_SIZE(HDRP(left)), left, bp) >= 0)) ||
+        (right != NULL && (!check_node(right, index) ||
+                           tree_cmp(GET_SIZE(HDRP(right)), right, bp) <= 0)))
+        check_report(bp, "tree children out of (size, address) order");
+#else
+    void *pred = GET_PRED(bp);
+    void *succ = GET_SUCC(bp);
+
+    if (pred == NULL ? seg_list[index] != bp
+                     : !check_node(pred, index) || GET_SUCC(pred) != bp)
+        check_report(bp, "free block is not linked from its predecessor");
+    if (succ != NULL && (!check_node(succ, index) || GET_PRED(succ) != bp))
+        check_report(bp, "successor does not link back");
+#endif
+}
 
-    if (exact_fit_count[index] > 0) {
-        exact_fit_count[index]--;
+/*
+ * check_node - 리스트(트리) 링크 p가 힙 안의, class index에 속하는 free 블록이면 1
+ */
+static int check_node(void *p, int index)
+{
+    return (uintptr_t)p % ALIGN_SIZE == 0 &&
+           mem_in_heap(HDRP(p), (char *)p + MIN_BLOCK_SIZE - WSIZE - 1) &&
+           !GET_ALLOC(HDRP(p)) &&
+           get_seg_index(GET_SIZE(HDRP(p))) == index;
+}
+
+#ifdef INDEX_TREE
+/*
+ * check_tree - (lo, hi) 키 범위 안에 있어야 할 서브트리 node의 노드 수 (최대 limit)
+ * 왼쪽 자식은 반복으로 따라가서 주소 순 삽입이 만드는 긴 왼쪽 사슬에서도 재귀가 깊어지지 않게
+ */
+static size_t check_tree(void *node, int index, void *lo, void *hi, size_t limit)
+{
+    size_t count = 0;
+
+    while (node != NULL && count < limit) {
+        if (!check_node(node, index)) {
+            check_report(node, "tree node is not a free block of its class");
+            break;
+        }
+        size_t size = GET_SIZE(HDRP(node));
+        if ((lo != NULL && tree_cmp(size, node, lo) <= 0) ||
+            (hi != NULL && tree_cmp(size, node, hi) >= 0)) {
+            check_report(node, "tree node out of (size, address) order");
+            break;
+        }
+        count++;
+        count += check_tree(GET_RIGHT(node), index, node, hi, limit - count);
+        hi = node;
+        node = GET_LEFT(node);
     }
+    return count;
+}
+#endif
+
+/*
+ * check_report - 문제 하나를 세고, 앞의 CHECK_REPORT개만 출력
+ */
+static void check_report(void *bp, const char *what)
+{
+    if (++check_problems <= CHECK_REPORT)
+        fprintf(stderr, "mm_check: block %p: %s\n", bp, what);
 }
+#endif
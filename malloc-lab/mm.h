@@ -4,6 +4,271 @@ extern int mm_init (void);
 extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
+extern void *mm_memalign(size_t align, size_t size);
+extern void mm_free_sized(void *ptr, size_t size);
+extern int mm_try_expand(void *ptr, size_t size);
+extern size_t mm_usable_size(void *ptr);
+extern size_t mm_malloc_batch(size_t size, size_t n, void **ptrs);
+extern void mm_free_batch(void **ptrs, size_t n);
+
+/*
+ * Allocation policies, selectable at run time: mm_set_policy returns -1
+ * if this build has no policy of that name, and mm_policy_name(i) lists
+ * them (NULL past the last one). Call it between traces, not while
+ * blocks are being allocated on other threads.
+ */
+extern int mm_set_policy(const char *name);
+extern const char *mm_policy_name(int i);
+
+/*
+ * Tuning parameters. Defaults are mm.c's compile-time constants;
+ * mm_set_params returns -1 and changes nothing if a value is out of
+ * range (sizes must be multiples of the alignment, 8 or with -DALIGN16
+ * 16, chunk_size at most 16 MB, trim_threshold above the 64 KB kept at
+ * the heap end).
+ */
+typedef struct {
+    size_t chunk_size;      /* smallest heap extension, in bytes */
+    size_t split_min;       /* smallest remainder place() splits off */
+    size_t split_high;      /* carve requests this large from the block end (0: policy's) */
+    size_t hot_min_count;   /* sketch count that makes a size hot */
+    size_t hot_cold_count;  /* decayed count below which a hot size is dropped */
+    size_t hot_window;      /* allocations between two sketch decays */
+    size_t hot_list_max;    /* blocks kept per quick list */
+    size_t trim_threshold;  /* free blocks this large are trimmed or released */
+} mm_params_t;
+
+extern void mm_get_params(mm_params_t *params);
+extern int mm_set_params(const mm_params_t *params);
+
+/*
+ * Fixed-size fast path for requests whose size is a compile-time
+ * constant, such as those of typed allocation wrappers:
+ *
+ *     struct node *p = mm_malloc_fixed(sizeof(struct node));
+ *     ...
+ *     mm_free_fixed(p, sizeof(struct node));
+ *
+ * The compiler folds the size into a block size (MM_ASIZE, the same
+ * rounding as mm.c) and a bin. A hit pops the bin's first block, a
+ * block that stays allocated in the heap, so there is no search, split
+ * or header write; a miss or a full bin calls into mm.c, which moves
+ * blocks between the bin and the heap MM_FIXED_BATCH at a time.
+ * Popping mm.c's class list instead would cost a call, an unlink and
+ * the header and footer writes of a free block on every request,
+ * which is what the bins are there to skip (fixedbench measures both).
+ * Since find_fit cannot see the bins, they hold at most MM_FIXED_CAP
+ * bytes in all, and mm.c empties them into the free index before it
+ * grows the heap.
+ * Blocks are ordinary heap blocks that mm_free and mm_realloc accept,
+ * but mm_free_fixed only takes blocks of that size from the block heap
+ * (e.g. not from mm_malloc in a SLAB_TIER build). Sizes above
+ * MM_FIXED_MAX go to mm_malloc and mm_free. The bins are not locked:
+ * THREAD_CACHE builds map both calls to mm_malloc and mm_free_sized,
+ * whose per-thread bins already are such a path.
+ */
+#ifdef COMPACT_LINKS
+#define MM_MIN_BLOCK 16         /* mm.c's MIN_BLOCK_SIZE */
+#elif defined(ALIGN16)
+#define MM_MIN_BLOCK 32
+#else
+#define MM_MIN_BLOCK 24
+#endif
+#ifdef ALIGN16
+#define MM_ALIGN 16             /* mm.c's ALIGN_SIZE */
+#else
+#define MM_ALIGN 8
+#endif
+
+/* Block size of a size-byte request (mm.c's adjust_size) */
+#if defined(COMPACT_LINKS) || defined(ALIGN16)
+#define MM_ASIZE(size) ((size_t)(size) <= MM_MIN_BLOCK - 4 ? (size_t)MM_MIN_BLOCK : \
+    (size_t)MM_ALIGN * (((size_t)(size) + 4 + MM_ALIGN - 1) / MM_ALIGN))
+#else
+#define MM_ASIZE(size) ((size_t)(size) <= 16 ? (size_t)MM_MIN_BLOCK : \
+    (size_t)8 * (((size_t)(size) + 8 + 7) / 8))
+#endif
+
+#define MM_FIXED_MAX 512        /* largest block size with a bin */
+#define MM_FIXED_BINS (MM_FIXED_MAX / 8 + 1)
+#define MM_FIXED_BIN_MAX 64     /* blocks a bin holds before it drains */
+#define MM_FIXED_BATCH 16       /* blocks moved per refill or drain */
+#define MM_FIXED_CAP (32 << 10) /* bytes all bins together may hold */
+
+#ifdef THREAD_CACHE
+#define mm_malloc_fixed(size) mm_malloc(size)
+#define mm_free_fixed(ptr, size) mm_free_sized((ptr), (size))
+#else
+extern void *mm_fixed_bin[MM_FIXED_BINS];       /* LIFO, linked through the payload */
+extern unsigned int mm_fixed_len[MM_FIXED_BINS];
+extern size_t mm_fixed_bytes;                   /* block bytes in all bins */
+extern void *mm_fixed_refill(size_t asize);
+extern void mm_fixed_drain(size_t asize);
+
+static inline void *mm_fixed_alloc(size_t asize)
+{
+    void *p = mm_fixed_bin[asize / 8];
+
+    if (__builtin_expect(p == NULL, 0))
+        return mm_fixed_refill(asize);
+    mm_fixed_bin[asize / 8] = *(void **)p;
+    mm_fixed_len[asize / 8]--;
+    mm_fixed_bytes -= asize;
+    return p;
+}
+
+static inline void mm_fixed_free(void *p, size_t asize)
+{
+    if (p == NULL)
+        return;
+    *(void **)p = mm_fixed_bin[asize / 8];
+    mm_fixed_bin[asize / 8] = p;
+    mm_fixed_bytes += asize;
+    if (__builtin_expect(++mm_fixed_len[asize / 8] > MM_FIXED_BIN_MAX ||
+                         mm_fixed_bytes > MM_FIXED_CAP, 0))
+        mm_fixed_drain(asize);
+}
+
+#define mm_malloc_fixed(size)                                   \
+    ((size) == 0 ? NULL                                         \
+     : MM_ASIZE(size) <= MM_FIXED_MAX ? mm_fixed_alloc(MM_ASIZE(size)) \
+     : mm_malloc(size))
+#define mm_free_fixed(ptr, size)                                \
+    (MM_ASIZE(size) <= MM_FIXED_MAX ? mm_fixed_free((ptr), MM_ASIZE(size)) \
+     : mm_free(ptr))
+#endif
+
+#ifdef MM_STATS
+/*
+ * Allocator-internal counters, compiled in with -DMM_STATS (make STATS=1).
+ * Counters cover the shared heap since the last mm_init; the per-class
+ * occupancy arrays are filled in by walking the heap when mm_stats is
+ * called. Walk histograms count searches that visited 0, 1, 2-3, 4-7,
+ * ... blocks, with the last bucket collecting everything longer.
+ */
+#define MM_STATS_CLASSES 112     /* size classes of mm.c (SEG_LIST_COUNT) */
+#define MM_STATS_WALK_BUCKETS 16
+
+typedef struct {
+    /* searches of the free index */
+    unsigned long fit_calls;        /* find_fit lookups */
+    unsigned long fit_misses;       /* ... that found nothing */
+    unsigned long fit_walk_total;   /* free blocks (or tree nodes) visited */
+    unsigned long fit_walk_hist[MM_STATS_WALK_BUCKETS];
+    unsigned long insert_calls;     /* free blocks put into the index */
+    unsigned long insert_walk_total;
+    unsigned long insert_walk_hist[MM_STATS_WALK_BUCKETS];
+
+    /* place: how the chosen free block was cut */
+    unsigned long place_calls;
+    unsigned long split_low;        /* request at the front, rest freed */
+    unsigned long split_high;       /* request at the end, rest freed */
+    unsigned long no_split;         /* whole block handed out */
+
+    /* coalesce by case: 0 none, 1 next, 2 prev, 3 both neighbors free */
+    unsigned long coalesce_cases[4];
+
+    /* heap growth and shrinking */
+    unsigned long extend_calls;
+    unsigned long extend_bytes;
+    unsigned long new_regions;      /* extend_heap got a non-adjacent region */
+    unsigned long trim_calls;       /* top of heap given back through brk */
+    unsigned long trim_bytes;
+    unsigned long release_calls;    /* interior pages given back */
+    unsigned long release_bytes;
+
+    /* hot-size quick lists */
+    unsigned long quick_hits;
+    unsigned long quick_pushes;
+    unsigned long quick_consolidations;
+
+    /* deferred coalescing (-DDEFER_COALESCE) */
+    unsigned long deferred_frees;   /* frees parked unsorted */
+    unsigned long deferred_hits;    /* allocations served from them */
+    unsigned long deferred_drained; /* parked blocks coalesced later */
+
+    /* realloc and mm_try_expand outcomes */
+    unsigned long realloc_in_place;  /* fit already, or absorbed the next block */
+    unsigned long realloc_grew_top;  /* ... after growing the heap under it */
+    unsigned long realloc_grew_back; /* memmoved into the free previous block */
+    unsigned long realloc_shrunk;    /* split off the tail in place */
+    unsigned long realloc_moved;     /* copied to a new block */
+
+    /* other tiers */
+    unsigned long slab_allocs;
+    unsigned long large_allocs;
+
+    /* occupancy snapshot, by size class */
+    unsigned long quick_blocks;     /* blocks parked in quick or deferred lists */
+    unsigned long used_blocks[MM_STATS_CLASSES];
+    unsigned long used_bytes[MM_STATS_CLASSES];
+    unsigned long free_blocks[MM_STATS_CLASSES];
+    unsigned long free_bytes[MM_STATS_CLASSES];
+} mm_stats_t;
+
+extern void mm_stats(mm_stats_t *stats);
+
+/*
+ * Heap layout snapshot, filled in by mm_layout walking the block chain
+ * of every heap region from the prologue to the epilogue. Quick-list
+ * blocks are marked allocated in the heap, so they are counted in
+ * used_* and again in quick_*. Blocks of the slab and large tiers live
+ * outside the block heap and are not included.
+ */
+#define MM_LAYOUT_BUCKETS 24     /* free blocks of 2^(i+4) up to 2^(i+5)-1 bytes */
+
+typedef struct {
+    unsigned long used_blocks;      /* allocated blocks, headers included */
+    unsigned long used_bytes;
+    unsigned long free_blocks;
+    unsigned long free_bytes;
+    unsigned long largest_free;     /* size of the largest free block */
+    unsigned long quick_blocks;     /* allocated blocks parked in quick or deferred lists */
+    unsigned long quick_bytes;
+    unsigned long overhead_bytes;   /* prologues, epilogues and region pads */
+    unsigned long free_hist[MM_LAYOUT_BUCKETS];
+} mm_layout_t;
+
+extern void mm_layout(mm_layout_t *layout);
+#endif
+
+#ifdef MM_CHECK
+/*
+ * Heap checker, compiled in with -DMM_CHECK (make CHECK=1). mm_check
+ * walks every region's block chain and the free index: header/footer
+ * agreement, prev_alloc bits, no two adjacent free blocks, every free
+ * block listed once in its own size class, and the class bitmaps. It
+ * prints what it finds to stderr and returns the number of problems.
+ *
+ * mm_set_check makes every shared-heap operation check when it ends
+ * and abort() on a problem: MM_CHECK_FULL walks the whole heap,
+ * MM_CHECK_INCR checks only the blocks the operation touched (and
+ * their neighbors), MM_CHECK_SAMPLE walks the whole heap every nth
+ * operation. Thread-cache hits never reach the shared heap and are
+ * not counted.
+ */
+#define MM_CHECK_OFF    0
+#define MM_CHECK_FULL   1
+#define MM_CHECK_INCR   2
+#define MM_CHECK_SAMPLE 3
+
+extern int mm_check(void);
+extern void mm_set_check(int mode, unsigned long n);
+#endif
+
+#ifdef THREAD_CACHE
+/*
+ * Fork handlers, for pthread_atfork (mmshim.c registers them). The
+ * prepare handler takes the heap lock so no other thread is inside
+ * the shared heap when the process forks, and the parent handler
+ * releases it. The child handler re-initializes the lock and clears
+ * the caches of the threads that did not survive the fork; the blocks
+ * those caches held stay allocated in the child.
+ */
+extern void mm_fork_prepare(void);
+extern void mm_fork_parent(void);
+extern void mm_fork_child(void);
+#endif
 
 
 /* 
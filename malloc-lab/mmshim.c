@@ -0,0 +1,148 @@
+/*
+ * mmshim.c - The C allocation API on top of mm.c, built into libmm.so
+ *            so that mm.c can serve every allocation of a real program:
+ *
+ *                unix> make libmm.so
+ *                unix> LD_PRELOAD=./libmm.so ls -l
+ *
+ * The library is built with MEMLIB_MMAP, so the heap grows into
+ * reserved anonymous mappings instead of the fixed 20 MB arena, and
+ * with THREAD_CACHE, whose heap lock makes mm.c safe to call from
+ * several threads. mem_init and mm_init run on the first call, which
+ * also registers mm.c's fork handlers, so a child forked while other
+ * threads allocate does not inherit a held heap lock.
+ *
+ * It is also built with ALIGN16, because the x86-64 ABI promises
+ * 16-byte aligned malloc blocks and compilers rely on it. Larger
+ * alignments come from mm_memalign, whose blocks are ordinary blocks
+ * to free and realloc.
+ *
+ * In a CHECK=1 build the MM_CHECK environment variable (full, incr or
+ * a sampling interval n) turns on mm.c's heap checks for the program.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <malloc.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "config.h"
+
+static pthread_once_t shim_once = PTHREAD_ONCE_INIT;
+static int shim_ready = 0;
+
+static void shim_init(void);
+
+/*
+ * shim_init - Set up memlib and mm.c, once per process
+ */
+static void shim_init(void)
+{
+    mem_init();
+    if (mm_init() < 0)
+        abort();
+#ifdef MM_CHECK
+    char *mode = getenv("MM_CHECK");
+    if (mode != NULL) {
+        if (!strcmp(mode, "full"))
+            mm_set_check(MM_CHECK_FULL, 1);
+        else if (!strcmp(mode, "incr"))
+            mm_set_check(MM_CHECK_INCR, 1);
+        else if (strtoul(mode, NULL, 10) > 0)
+            mm_set_check(MM_CHECK_SAMPLE, strtoul(mode, NULL, 10));
+    }
+#endif
+    __atomic_store_n(&shim_ready, 1, __ATOMIC_RELEASE);
+
+    /* After shim_ready: pthread_atfork may call malloc */
+    pthread_atfork(mm_fork_prepare, mm_fork_parent, mm_fork_child);
+}
+
+#define SHIM_INIT()                                           \
+    do {                                                      \
+        if (!__atomic_load_n(&shim_ready, __ATOMIC_ACQUIRE))  \
+            pthread_once(&shim_once, shim_init);              \
+    } while (0)
+
+void *malloc(size_t size)
+{
+    void *p;
+
+    SHIM_INIT();
+    if ((p = mm_malloc(size ? size : 1)) == NULL)
+        errno = ENOMEM;
+    return p;
+}
+
+void free(void *ptr)
+{
+    mm_free(ptr);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (size != 0 && nmemb > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if ((p = malloc(nmemb * size)) != NULL)
+        memset(p, 0, nmemb * size);
+    return p;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    void *p;
+
+    if (ptr == NULL)
+        return malloc(size);
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+    if ((p = mm_realloc(ptr, size)) == NULL)
+        errno = ENOMEM;
+    return p;
+}
+
+size_t malloc_usable_size(void *ptr)
+{
+    return mm_usable_size(ptr);
+}
+
+int posix_memalign(void **memptr, size_t align, size_t size)
+{
+    void *p;
+
+    if (align < sizeof(void *) || (align & (align - 1)) != 0)
+        return EINVAL;
+    SHIM_INIT();
+    if ((p = mm_memalign(align, size ? size : 1)) == NULL)
+        return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    void *p;
+
+    if (align == 0 || (align & (align - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    SHIM_INIT();
+    if ((p = mm_memalign(align, size ? size : 1)) == NULL)
+        errno = ENOMEM;
+    return p;
+}
+
+void *memalign(size_t align, size_t size)
+{
+    return aligned_alloc(align, size);
+}
@@ -0,0 +1,95 @@
+/*
+ * rep2bin.c - Convert a text .rep trace into the binary trace format
+ *
+ * Usage: rep2bin <in.rep> <out.bin>
+ *
+ * The output is a tracehdr_t followed by one traceop_t per request
+ * (see trace.h). mdriver recognizes the magic number and maps the
+ * file directly instead of parsing it, so a converted trace loads in
+ * constant time. The requests are checked the same way read_trace
+ * checks them, so mdriver does not need to re-validate the file.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+#define MAXLINE 1024 /* max string size */
+
+static void conv_error(char *path, char *msg)
+{
+	fprintf(stderr, "rep2bin: %s: %s\n", path, msg);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *in, *out;
+	tracehdr_t hdr;
+	traceop_t op;
+	char type[MAXLINE];
+	unsigned index, size;
+	unsigned max_index = 0;
+	int op_index = 0;
+
+	if (argc != 3)
+	{
+		fprintf(stderr, "Usage: rep2bin <in.rep> <out.bin>\n");
+		exit(1);
+	}
+	if ((in = fopen(argv[1], "r")) == NULL)
+		conv_error(argv[1], "could not open");
+	if ((out = fopen(argv[2], "wb")) == NULL)
+		conv_error(argv[2], "could not create");
+
+	/* Copy the four header lines into the fixed binary header */
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, TRACE_MAGIC, TRACE_MAGIC_LEN);
+	if (fscanf(in, "%d %d %d %d", &hdr.sugg_heapsize, &hdr.num_ids,
+			   &hdr.num_ops, &hdr.weight) != 4)
+		conv_error(argv[1], "bad trace header");
+	hdr.op_size = sizeof(traceop_t);
+	if (fwrite(&hdr, sizeof(hdr), 1, out) != 1)
+		conv_error(argv[2], "write failed");
+
+	/* Stream the requests straight through to the output file */
+	memset(&op, 0, sizeof(op));
+	while (fscanf(in, "%s", type) != EOF)
+	{
+		size = 0;
+		switch (type[0])
+		{
+		case 'a':
+		case 'r':
+			if (fscanf(in, "%u %u", &index, &size) != 2)
+				conv_error(argv[1], "truncated request");
+			op.type = (type[0] == 'a') ? ALLOC : REALLOC;
+			max_index = (index > max_index) ? index : max_index;
+			break;
+		case 'f':
+			if (fscanf(in, "%u", &index) != 1)
+				conv_error(argv[1], "truncated request");
+			op.type = FREE;
+			break;
+		default:
+			conv_error(argv[1], "bogus request type");
+		}
+		if (index >= (unsigned)hdr.num_ids)
+			conv_error(argv[1], "request id out of range");
+		op.index = index;
+		op.size = size;
+		if (fwrite(&op, sizeof(op), 1, out) != 1)
+			conv_error(argv[2], "write failed");
+		op_index++;
+	}
+	fclose(in);
+
+	if (op_index != hdr.num_ops)
+		conv_error(argv[1], "op count does not match the header");
+	if (hdr.num_ids > 0 && max_index != (unsigned)hdr.num_ids - 1)
+		conv_error(argv[1], "id count does not match the header");
+	if (fclose(out) != 0)
+		conv_error(argv[2], "write failed");
+	return 0;
+}
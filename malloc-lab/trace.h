@@ -0,0 +1,41 @@
+/*
+ * trace.h - Trace requests shared by mdriver, rep2bin and gentrace
+ *
+ * Besides the text .rep format, mdriver reads a binary trace format
+ * produced by rep2bin and gentrace. A binary trace is a tracehdr_t followed by
+ * num_ops traceop_t records laid out exactly as they sit in memory,
+ * so mdriver can mmap the file and use the records as its op array
+ * without parsing or copying anything. Files are in host byte order.
+ */
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+/* Characterizes a single trace operation (allocator request) */
+typedef struct
+{
+	enum
+	{
+		ALLOC,
+		FREE,
+		REALLOC
+	} type;	   /* type of request */
+	int index; /* index for free() to use later */
+	int size;  /* byte size of alloc/realloc request */
+} traceop_t;
+
+#define TRACE_MAGIC "MMTRACE1" /* first 8 bytes of a binary trace */
+#define TRACE_MAGIC_LEN 8
+
+/* Fixed header of a binary trace file (32 bytes) */
+typedef struct
+{
+	char magic[TRACE_MAGIC_LEN]; /* TRACE_MAGIC, not NUL terminated */
+	int sugg_heapsize;			 /* same four fields as a .rep header */
+	int num_ids;
+	int num_ops;
+	int weight;
+	int op_size;				 /* sizeof(traceop_t) of the writer */
+	int reserved;				 /* keeps the ops 8-byte aligned */
+} tracehdr_t;
+
+#endif /* __TRACE_H_ */